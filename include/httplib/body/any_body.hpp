@@ -4,6 +4,8 @@
 #include "httplib/body/form_data_body.hpp"
 #include "httplib/body/json_body.hpp"
 #include "httplib/body/query_params_body.hpp"
+#include "httplib/body/shared_buffer_body.hpp"
+#include "httplib/body/stream_body.hpp"
 #include "httplib/body/string_body.hpp"
 
 namespace httplib::body {
@@ -57,6 +59,21 @@ struct any_body {
             static_assert(!std::is_void_v<body_type>, "No matching Body type found");
             return std::get<typename Body::value_type>(*this);
         }
+
+        // The bytes already carry the Content-Encoding of the message, e.g. a
+        // precompressed file, so the writer sends them as they are. Assigning a new
+        // body clears the flag.
+        bool is_encoded() const { return encoded_; }
+        void set_encoded(bool encoded) { encoded_ = encoded; }
+
+        // level the writer compresses with when it applies the Content-Encoding, -1
+        // for the library default
+        int compression_level() const { return compression_level_; }
+        void set_compression_level(int level) { compression_level_ = level; }
+
+    private:
+        bool encoded_ = false;
+        int compression_level_ = -1;
     };
 
     using value_type = variant_value<empty_body,
@@ -64,7 +81,9 @@ struct any_body {
                                      json_body,
                                      form_data_body,
                                      file_body,
-                                     query_params_body>;
+                                     query_params_body,
+                                     stream_body,
+                                     shared_buffer_body>;
 
     class writer {
     public:
@@ -6,9 +6,45 @@
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/http/message.hpp>
 #include <fmt/format.h>
-#include <fstream>
+#include <memory>
 
 namespace httplib::body {
+
+/** A read-only open file shared by every response serving it
+
+    Reads are positional, pread(2) on POSIX, so concurrent responses never race
+    on a shared file offset.
+*/
+class shared_file {
+public:
+    using native_handle_type = beast::file::native_handle_type;
+
+    static std::shared_ptr<const shared_file>
+    open(const fs::path& path, boost::system::error_code& ec);
+
+    std::size_t
+    read_at(std::uint64_t offset,
+            void* buffer,
+            std::size_t n,
+            boost::system::error_code& ec) const;
+
+    std::uint64_t
+    size() const
+    {
+        return size_;
+    }
+    // the OS file handle, a file descriptor on POSIX
+    native_handle_type
+    native_handle() const
+    {
+        return file_.native_handle();
+    }
+
+private:
+    beast::file file_;
+    std::uint64_t size_ = 0;
+};
+
 struct file_body {
     struct value_type {
         html::http_ranges ranges;
@@ -18,41 +54,41 @@ struct file_body {
         std::size_t
         file_size() const
         {
-            return file_size_;
+            return file_ ? file_->size() : 0;
         }
 
-        void
-        seekg(std::ios::off_type _Off, std::ios_base::seekdir _Way = std::ios::cur)
+        std::size_t
+        read_at(std::uint64_t offset, void* buffer, std::size_t n) const
         {
-            file_.seekg(_Off, _Way);
+            boost::system::error_code ec;
+            auto bytes = file_->read_at(offset, buffer, n, ec);
+            return ec ? 0 : bytes;
         }
-        std::size_t
-        read(void* buffer, std::size_t n)
+        void
+        open(const fs::path& path)
         {
-            file_.read((char*)buffer, n);
-            return file_.gcount();
+            boost::system::error_code ec;
+            file_ = shared_file::open(path, ec);
         }
+        // serve an already open file, e.g. one handed out by the static file cache
         void
-        open(const fs::path& path,
-             std::ios_base::openmode mode = std::ios_base::in | std::ios_base::out)
+        assign(std::shared_ptr<const shared_file> file)
         {
-            file_size_ = 0;
-            file_.open(path, mode);
-            if (file_) {
-                file_.seekg(0, std::ios::end);
-                file_size_ = file_.tellg();
-                file_.seekg(0, std::ios::beg);
-            }
+            file_ = std::move(file);
         }
         bool
         is_open() const
         {
-            return file_.is_open();
+            return !!file_;
+        }
+        shared_file::native_handle_type
+        native_handle() const
+        {
+            return file_->native_handle();
         }
 
     private:
-        std::fstream file_;
-        std::size_t file_size_ = 0;
+        std::shared_ptr<const shared_file> file_;
     };
 
     class writer {
@@ -75,7 +111,6 @@ struct file_body {
         enum class step { header, content, content_end, eof };
         step step_ = step::header;
         char buf_[BOOST_BEAST_FILE_BUFFER_SIZE];
-        std::size_t file_size_;
     };
     //--------------------------------------------------------------------------
 
@@ -0,0 +1,54 @@
+#pragma once
+#include "httplib/config.hpp"
+#include <boost/beast/http/fields.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace httplib::body {
+
+struct shared_buffer_body {
+    /** An immutable buffer shared by every message that sends it
+
+        Used for cached content such as compressed static files, the bytes are
+        written straight from the shared buffer without a copy.
+    */
+    struct value_type {
+        std::shared_ptr<const std::string> data;
+    };
+
+    /** Shared buffers are never parsed from the wire
+     */
+    class reader {
+    public:
+        explicit reader(const http::fields&, value_type&);
+
+        void
+        init(boost::optional<std::uint64_t> const&, beast::error_code& ec);
+        std::size_t
+        put(net::const_buffer const&, beast::error_code& ec);
+        void
+        finish(beast::error_code& ec);
+    };
+
+    class writer {
+        value_type const& body_;
+
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        explicit writer(const http::fields&, value_type const& b);
+
+        void
+        init(beast::error_code& ec)
+        {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>>
+        get(beast::error_code& ec);
+    };
+};
+
+} // namespace httplib::body
@@ -0,0 +1,59 @@
+#pragma once
+#include "httplib/config.hpp"
+#include <boost/asio/awaitable.hpp>
+#include <boost/beast/http/fields.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace httplib::body {
+
+struct stream_body {
+    /** A body produced while it is being written
+
+        The producer is awaited for each chunk once the previous one has been
+        written to the socket, so a slow peer holds the producer back. An empty
+        string ends the body. Chunked transfer encoding is used unless the
+        response carries a Content-Length.
+
+        The chunks are sent as they are, a Content-Encoding set by the handler
+        describes what the producer returns. Only when the server picks the
+        encoding itself is `compress` set and the chunks encoded on their way out.
+    */
+    struct value_type {
+        std::function<net::awaitable<std::string>()> producer;
+        bool compress = false;
+    };
+
+    /** Stream bodies are never parsed from the wire
+     */
+    class reader {
+    public:
+        explicit reader(const http::fields&, value_type&);
+
+        void
+        init(boost::optional<std::uint64_t> const&, beast::error_code& ec);
+        std::size_t
+        put(net::const_buffer const&, beast::error_code& ec);
+        void
+        finish(beast::error_code& ec);
+    };
+
+    /** Only the session can await the producer, the synchronous writer
+        fails with operation_not_supported
+    */
+    class writer {
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        explicit writer(const http::fields&, value_type const&);
+
+        void
+        init(beast::error_code& ec);
+        boost::optional<std::pair<const_buffers_type, bool>>
+        get(beast::error_code& ec);
+    };
+};
+
+} // namespace httplib::body
@@ -0,0 +1,33 @@
+#pragma once
+#include "httplib/config.hpp"
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/system/error_code.hpp>
+#include <string>
+
+namespace httplib {
+
+// Request body handed to streaming handlers, the ones taking
+// (request&, response&, body_reader&). The session does not buffer the body of such
+// routes; the handler pulls it through the reader with memory bounded by its own
+// buffers. Whatever the handler leaves unread is discarded by closing the connection.
+class body_reader {
+public:
+    virtual ~body_reader() = default;
+
+    // Reads up to `buffer.size()` bytes of the decoded body, chunked framing already
+    // removed. Returns 0 once the body is complete, and right away for an empty
+    // `buffer`, like Asio's read_some. A body crossing the route limit fails with
+    // http::error::body_limit.
+    virtual net::awaitable<std::size_t>
+    async_read_some(net::mutable_buffer buffer, boost::system::error_code& ec) = 0;
+
+    // appends the rest of the body to `out`, stops with body_limit past `max_size`
+    net::awaitable<void> async_read_all(std::string& out,
+                                        std::size_t max_size,
+                                        boost::system::error_code& ec);
+
+    virtual bool is_done() const = 0;
+};
+
+} // namespace httplib
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace httplib {
+
+// occupancy of the pool lending I/O buffers to proxy tunnels, process wide
+struct buffer_pool_stats {
+    // buffers lent out right now and their total size
+    std::size_t buffers_in_use = 0;
+    std::size_t bytes_in_use = 0;
+    // released buffers the threads keep for reuse
+    std::size_t idle_buffers = 0;
+    std::size_t idle_bytes = 0;
+    // requests served from an idle buffer versus ones that had to allocate
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+};
+
+} // namespace httplib
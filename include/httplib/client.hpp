@@ -1,6 +1,7 @@
 #pragma once
 #include "httplib/body/any_body.hpp"
 #include "httplib/config.hpp"
+#include "httplib/tls_stats.hpp"
 #include <boost/asio/awaitable.hpp>
 #include <filesystem>
 #include <limits>
@@ -29,6 +30,8 @@ public:
     void set_timeout_policy(const timeout_policy& policy);
 
     void set_timeout(const std::chrono::steady_clock::duration& duration);
+    // head start of each connect attempt over the next address, see RFC 8305
+    void set_connect_attempt_delay(const std::chrono::steady_clock::duration& duration);
     void set_use_ssl(bool ssl);
 
 public:
@@ -53,6 +56,9 @@ public:
     void close();
     bool is_connected();
 
+    // full versus resumed TLS handshakes made by this client
+    tls_handshake_stats tls_stats() const;
+
 private:
     class impl;
     impl* impl_;
@@ -0,0 +1,85 @@
+#pragma once
+#include "httplib/client.hpp"
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace httplib {
+
+// Thread-safe pool of keep-alive clients keyed by scheme, host and port.
+//
+// A lease hands out one client exclusively and gives it back to the pool when it is
+// destroyed. Requests still go through the client's own request path; the pool only
+// decides which connection is used. Idle connections are reused most recently used
+// first, dropped after `idle_timeout`, and checked with a non-blocking peek before they
+// are handed out again.
+class client_pool {
+    class impl;
+
+public:
+    struct options {
+        // connections per host, idle and in use
+        std::size_t max_per_host = 32;
+        // idle connections kept per host
+        std::size_t max_idle_per_host = 8;
+        std::chrono::steady_clock::duration idle_timeout = std::chrono::seconds(60);
+        // request timeout of the pooled clients, also bounds the wait for a free slot
+        std::chrono::steady_clock::duration timeout = std::chrono::seconds(30);
+    };
+
+    class lease {
+    public:
+        lease() = default;
+        lease(lease&&) = default;
+        lease& operator=(lease&& other) noexcept;
+        ~lease();
+
+        client* operator->() const noexcept { return client_.get(); }
+        client& operator*() const noexcept { return *client_; }
+        explicit operator bool() const noexcept { return !!client_; }
+
+    private:
+        lease(std::shared_ptr<impl> pool, std::string key, std::unique_ptr<client> c);
+        void release();
+
+        std::shared_ptr<impl> pool_;
+        std::string key_;
+        std::unique_ptr<client> client_;
+
+        friend class client_pool;
+    };
+
+    using lease_result = boost::system::result<lease>;
+
+public:
+    explicit client_pool(const net::any_io_executor& ex, const options& opts);
+    explicit client_pool(const net::any_io_executor& ex);
+    ~client_pool();
+
+    // waits for a free slot when `max_per_host` connections are in use
+    net::awaitable<lease_result>
+    async_acquire(std::string_view scheme, std::string_view host, uint16_t port);
+
+    net::awaitable<client::response_result>
+    async_get(std::string_view scheme,
+              std::string_view host,
+              uint16_t port,
+              std::string_view path,
+              const html::query_params& params = {},
+              const http::fields& headers = http::fields());
+    net::awaitable<client::response_result>
+    async_post(std::string_view scheme,
+               std::string_view host,
+               uint16_t port,
+               std::string_view path,
+               std::string_view body,
+               const http::fields& headers = http::fields());
+
+    // drops idle connections older than `idle_timeout`
+    void evict_idle();
+    std::size_t idle_count() const;
+
+private:
+    std::shared_ptr<impl> impl_;
+};
+} // namespace httplib
@@ -0,0 +1,72 @@
+#pragma once
+#include "httplib/config.hpp"
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace httplib {
+
+// Process wide cache of host name lookups, used by the client and the CONNECT proxy.
+//
+// Answers are kept for `ttl`, failed lookups for `negative_ttl`. An expired answer is
+// still served for up to `stale_ttl` while a single background lookup refreshes it,
+// and a refresh that fails keeps the old answer. Concurrent misses for the same name
+// wait for one lookup instead of each queueing on the resolver. IP literals never
+// reach the resolver.
+//
+// The lookups themselves go through a replaceable resolve function, getaddrinfo by
+// default; tests can install a stub:
+//
+//   dns_cache::instance().set_resolver(
+//       [](const std::string& host, const std::string& service, auto& ec)
+//           -> net::awaitable<dns_cache::results_type> {
+//           auto ep = tcp::endpoint(net::ip::make_address("127.0.0.1"), 8080);
+//           co_return dns_cache::results_type::create(ep, host, service);
+//       });
+class dns_cache {
+    class impl;
+
+public:
+    using results_type = tcp::resolver::results_type;
+    using resolve_function =
+        std::function<net::awaitable<results_type>(const std::string& host,
+                                                    const std::string& service,
+                                                    boost::system::error_code& ec)>;
+
+    struct options {
+        // getaddrinfo does not report record TTLs, answers live this long
+        std::chrono::steady_clock::duration ttl = std::chrono::seconds(60);
+        std::chrono::steady_clock::duration negative_ttl = std::chrono::seconds(5);
+        // how long past `ttl` an answer is served while it is refreshed
+        std::chrono::steady_clock::duration stale_ttl = std::chrono::seconds(30);
+        // how long a caller waits for a lookup of the same name started by another one
+        std::chrono::steady_clock::duration timeout = std::chrono::seconds(10);
+        std::size_t max_entries = 4096;
+    };
+
+    static dns_cache& instance();
+
+    dns_cache();
+    explicit dns_cache(const options& opts, resolve_function resolver = {});
+    ~dns_cache();
+
+    void set_options(const options& opts);
+    // an empty function restores the system resolver
+    void set_resolver(resolve_function resolver);
+
+    net::awaitable<results_type> async_resolve(std::string_view host,
+                                               std::string_view service,
+                                               boost::system::error_code& ec);
+
+    void clear();
+    std::size_t size() const;
+
+private:
+    std::shared_ptr<impl> impl_;
+};
+
+} // namespace httplib
@@ -16,6 +16,9 @@ using query_params = std::unordered_multimap<std::string, std::string>;
 
 query_params
 parse_http_query_params(std::string_view content, bool& is_valid);
+// same acceptance as parse_http_query_params, without building the map
+bool
+is_valid_http_query_params(std::string_view content);
 std::string
 make_http_query_params(const query_params& params);
 
@@ -36,6 +39,14 @@ format_http_gmt_date(const std::time_t& time);
 std::time_t
 parse_http_gmt_date(const std::string& http_date);
 
+// whether a conditional GET is answered 304; If-Modified-Since is only evaluated
+// without an If-None-Match (RFC 9110, 13.1.3)
+bool
+is_not_modified(std::string_view if_none_match,
+                std::string_view if_modified_since,
+                std::string_view etag,
+                std::string_view last_modified);
+
 // parser_http_ranges 用于解析 http range 请求头.
 http_ranges
 parser_http_ranges(std::string_view range_str, size_t file_size, bool& is_valid) noexcept;
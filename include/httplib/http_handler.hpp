@@ -1,11 +1,26 @@
 #pragma once
+#include "httplib/body_reader.hpp"
 #include "httplib/variant_handler.hpp"
 #include "request.hpp"
 #include "response.hpp"
+#include <limits>
+#include <memory>
 namespace httplib {
 using coro_http_handler_type =
     std::function<net::awaitable<void>(request& req, response& resp)>;
 using http_handler_type = std::function<void(request& req, response& resp)>;
+using coro_stream_http_handler_type =
+    std::function<net::awaitable<void>(request& req, response& resp, body_reader& body)>;
+
+// what the session has to know about a route before it reads the request body
+struct route_info {
+    std::uint64_t body_limit = std::numeric_limits<std::uint64_t>::max();
+    // the handler reads the body itself through a body_reader
+    bool stream_body = false;
+    // the routing table the lookup ran against, pass it on through
+    // request::route_snapshot so that routing() dispatches on the same routes
+    std::shared_ptr<const void> snapshot;
+};
 
 using http_handler_variant = variant_handler<http_handler_type, coro_http_handler_type>;
 
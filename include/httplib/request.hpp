@@ -2,10 +2,54 @@
 #include "httplib/body/any_body.hpp"
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/http/message.hpp>
-#include <regex>
+#include <boost/container/small_vector.hpp>
+#include <optional>
+#include <string_view>
+#include <utility>
 
 namespace httplib {
 
+class body_reader;
+
+// Path parameters of a radix route, e.g. {"id", "42"} for "/users/:id". Names and
+// values are views into the route table and the request, valid while the handler runs.
+class route_params {
+public:
+    using value_type = std::pair<std::string_view, std::string_view>;
+
+    std::string_view
+    operator[](std::string_view name) const
+    {
+        for (const auto& param : params_) {
+            if (param.first == name) return param.second;
+        }
+        return {};
+    }
+    bool
+    contains(std::string_view name) const
+    {
+        for (const auto& param : params_) {
+            if (param.first == name) return true;
+        }
+        return false;
+    }
+
+    auto begin() const { return params_.begin(); }
+    auto end() const { return params_.end(); }
+    std::size_t size() const { return params_.size(); }
+    bool empty() const { return params_.empty(); }
+
+    void push_back(std::string_view name, std::string_view value)
+    {
+        params_.emplace_back(name, value);
+    }
+    void pop_back() { params_.pop_back(); }
+    void clear() { params_.clear(); }
+
+private:
+    boost::container::small_vector<value_type, 4> params_;
+};
+
 struct request : public http::request<body::any_body> { 
     using http::request<body::any_body>::message;
 
@@ -14,13 +58,26 @@ struct request : public http::request<body::any_body> {
 public:
     net::ip::address get_client_ip() const;
 
+    // parsed from the target on first use; routing() already rejected malformed
+    // queries with 400. This used to be a data member: `req.query_params` becomes
+    // `req.query_params()`, and the params can no longer be modified.
+    const html::query_params& query_params() const;
+
 public:
     std::string path;
-    html::query_params query_params;
-    std::unordered_map<std::string, std::string> path_params;
-    std::smatch matches;
+    route_params path_params;
+    // captures of a regex route as views into `path`, matches[0] is the whole path
+    boost::container::small_vector<std::string_view, 8> matches;
     tcp::endpoint local_endpoint;
     tcp::endpoint remote_endpoint;
+    // unread body of a streaming route, only set while its handler runs
+    body_reader* body_stream = nullptr;
+    // route_info::snapshot of the has_handler() lookup, routing() loads the current
+    // table when empty
+    std::shared_ptr<const void> route_snapshot;
+
+private:
+    mutable std::optional<html::query_params> query_params_;
 };
 
 
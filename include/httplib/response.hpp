@@ -39,9 +39,29 @@ public:
     void
     set_file_content(const fs::path& path, const http::fields& req_header = {});
 
+    // `path` already holds the content encoded as `content_encoding`, e.g. a ".br"
+    // sidecar; it is sent as is and labelled `content_type`
+    void
+    set_file_content(const fs::path& path,
+                     const http::fields& req_header,
+                     std::string_view content_encoding,
+                     std::string_view content_type);
+
     void
     set_form_data_content(const std::vector<form_data::field>& data);
 
+    // `data` is sent without a copy and must not change while it is shared
+    void
+    set_shared_content(std::shared_ptr<const std::string> data,
+                       std::string_view content_type,
+                       http::status status = http::status::ok);
+
+    // the body is pulled from `producer` while it is written, see body::stream_body
+    void
+    set_stream_content(std::function<net::awaitable<std::string>()> producer,
+                       std::string_view content_type,
+                       http::status status = http::status::ok);
+
     void
     set_redirect(std::string_view url,
                  http::status status = http::status::moved_permanently);
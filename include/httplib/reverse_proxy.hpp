@@ -0,0 +1,78 @@
+#pragma once
+#include "httplib/body_reader.hpp"
+#include "httplib/request.hpp"
+#include "httplib/response.hpp"
+#include <boost/asio/awaitable.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace httplib {
+
+// Route handler forwarding requests to a group of plain HTTP upstream servers.
+//
+//   router.set_http_handler<http::verb::get, http::verb::post>(
+//       "/api/*path", httplib::reverse_proxy({{"10.0.0.1", 8080}, {"10.0.0.2", 8080}}));
+//
+// Request and response bodies are streamed through in chunks, never buffered whole.
+// Upstream connections are kept alive and reused. An upstream failing `max_failures`
+// requests in a row (connect errors, timeouts, 502/503/504) is ejected for a while,
+// longer each time it happens again. Copies of a reverse_proxy share their upstreams,
+// connections and health state.
+class reverse_proxy {
+    class impl;
+
+public:
+    enum class balance
+    {
+        round_robin,
+        // the upstream with the fewest requests in flight
+        least_connections,
+        // the same key always goes to the same upstream while it is healthy
+        consistent_hash
+    };
+
+    struct upstream {
+        std::string host;
+        uint16_t port = 80;
+    };
+
+    struct options {
+        balance policy = balance::round_robin;
+        // request header consistent_hash keys on, the client address when empty or absent
+        std::string hash_header;
+
+        std::size_t max_idle_per_upstream = 16;
+        std::chrono::steady_clock::duration idle_timeout = std::chrono::seconds(60);
+        std::chrono::steady_clock::duration connect_timeout = std::chrono::seconds(5);
+        // attempts over the resolved addresses start this far apart (RFC 8305)
+        std::chrono::steady_clock::duration connect_attempt_delay =
+            std::chrono::milliseconds(250);
+        // bounds every read and write on an upstream connection
+        std::chrono::steady_clock::duration timeout = std::chrono::seconds(30);
+
+        // consecutive failures that eject an upstream
+        std::uint32_t max_failures = 5;
+        // doubled for every repeated ejection, up to eight times as long
+        std::chrono::steady_clock::duration ejection_time = std::chrono::seconds(30);
+        // never eject more than this share of the upstreams
+        double max_ejection_ratio = 0.5;
+    };
+
+public:
+    reverse_proxy(std::vector<upstream> upstreams, const options& opts);
+    explicit reverse_proxy(std::vector<upstream> upstreams);
+    ~reverse_proxy();
+
+    net::awaitable<void>
+    operator()(request& req, response& resp, body_reader& body) const;
+
+    // upstreams not ejected right now
+    std::size_t healthy_count() const;
+
+private:
+    std::shared_ptr<impl> impl_;
+};
+
+} // namespace httplib
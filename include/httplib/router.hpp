@@ -5,11 +5,24 @@
 #include <boost/asio/detached.hpp>
 #include <boost/beast/http/fields.hpp>
 #include <filesystem>
+#include <limits>
 #include <list>
 #include <string>
 #include <string_view>
 
 namespace httplib {
+
+// Route aspect capping the request body a handler accepts. The tighter of this and
+// server::setting::max_body_size applies; requests announcing a larger Content-Length
+// are answered with 413 before their body is read.
+struct body_limit
+{
+    std::uint64_t max_size = std::numeric_limits<std::uint64_t>::max();
+};
+
+// Routes, handlers and mount points can be changed while the server runs. Every change
+// publishes a new route table; requests in flight finish on the table they started
+// with.
 class router
 {
   public:
@@ -18,6 +31,9 @@ class router
 
   public:
     // eg: "GET hello/" as a key
+    // Handlers are (request&, response&) and get the whole body in request::body(),
+    // or (request&, response&, body_reader&) returning net::awaitable<void> and read the
+    // body themselves while it arrives.
     template<typename Func, typename... Aspects>
     void
     set_http_handler(http::verb method,
@@ -47,16 +63,22 @@ class router
     void
     set_file_request_handler(Func&& handler, Aspects&&... asps);
 
+    // With `precompressed` set, a request for "app.js" is answered from "app.js.br",
+    // "app.js.zst" or "app.js.gz" when one exists and the client accepts its encoding.
     bool
     set_mount_point(const std::string& mount_point,
                     const std::filesystem::path& dir,
-                    const http::fields& headers = {});
+                    const http::fields& headers = {},
+                    bool precompressed = false);
 
     bool
     remove_mount_point(const std::string& mount_point);
 
     bool
     has_handler(http::verb method, std::string_view target) const;
+    // same as above, also reports how the matched route takes its body
+    bool
+    has_handler(http::verb method, std::string_view target, route_info& info) const;
 
     net::awaitable<void>
     routing(request& req, response& resp);
@@ -65,7 +87,8 @@ class router
     void
     set_http_handler_impl(http::verb method,
                           std::string_view key,
-                          coro_http_handler_type&& handler);
+                          coro_http_handler_type&& handler,
+                          const route_info& info);
     void
     set_default_handler_impl(coro_http_handler_type&& handler);
     void
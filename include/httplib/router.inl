@@ -27,6 +27,32 @@ constexpr bool has_before_v = has_before<T>::value;
 template<class T>
 constexpr bool has_after_v = has_after<T>::value;
 
+template<typename... Aspects>
+constexpr std::uint64_t
+route_body_limit(const Aspects&... asps)
+{
+    std::uint64_t limit = std::numeric_limits<std::uint64_t>::max();
+    (
+        [&](const auto& aspect) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(aspect)>, body_limit>)
+                limit = std::min(limit, aspect.max_size);
+        }(asps),
+        ...);
+    return limit;
+}
+
+template<typename Func, typename = void>
+struct is_stream_handler : std::false_type { };
+
+template<typename Func>
+struct is_stream_handler<
+    Func,
+    std::enable_if_t<std::tuple_size_v<util::function_parameters_t<Func>> == 3>>
+    : std::is_same<util::last_parameters_type_t<Func>, body_reader> { };
+
+template<typename Func>
+constexpr inline bool is_stream_handler_v = is_stream_handler<Func>::value;
+
 template<typename T>
 constexpr inline bool is_awaitable_v =
     util::is_specialization_v<std::remove_cvref_t<T>, net::awaitable>;
@@ -67,7 +93,21 @@ create_http_handler_variant(Func&& handler)
     http_handler_variant handler_variant;
     using return_type =
         typename util::function_traits<std::decay_t<decltype(handler)>>::return_type;
-    if constexpr (is_awaitable_v<return_type>) {
+    if constexpr (is_stream_handler_v<Func>) {
+        static_assert(is_awaitable_v<return_type>,
+                      "streaming handlers must return net::awaitable<void>");
+        // the session sets request::body_stream for every route registered this way
+        handler_variant = coro_http_handler_type(
+            [handler = coro_stream_http_handler_type(std::move(handler))](
+                request& req, response& resp) -> net::awaitable<void> {
+                // routed without the session setting up the body, nothing to read from
+                if (!req.body_stream) {
+                    resp.set_error_content(http::status::internal_server_error);
+                    co_return;
+                }
+                co_await handler(req, resp, *req.body_stream);
+            });
+    } else if constexpr (is_awaitable_v<return_type>) {
         handler_variant = coro_http_handler_type(std::move(handler));
     } else {
         handler_variant = http_handler_type(std::move(handler));
@@ -109,10 +149,13 @@ router::set_http_handler(http::verb method,
                          Func&& handler,
                          Aspects&&... asps)
 {
+    route_info info;
+    info.body_limit = detail::route_body_limit(asps...);
+    info.stream_body = detail::is_stream_handler_v<Func>;
     coro_http_handler_type http_handler =
         detail::create_router_coro_http_handler(std::move(handler), asps...);
 
-    set_http_handler_impl(method, key, std::move(http_handler));
+    set_http_handler_impl(method, key, std::move(http_handler), info);
 }
 
 template<http::verb... method, typename Func, typename... Aspects>
@@ -124,7 +167,14 @@ router::set_http_handler(std::string_view key,
 {
     static_assert(std::is_member_function_pointer_v<Func>, "must be member function");
     using return_type = typename util::function_traits<Func>::return_type;
-    if constexpr (detail::is_awaitable_v<return_type>) {
+    if constexpr (detail::is_stream_handler_v<Func>) {
+        coro_stream_http_handler_type f = std::bind(handler,
+                                                    &owner,
+                                                    std::placeholders::_1,
+                                                    std::placeholders::_2,
+                                                    std::placeholders::_3);
+        set_http_handler<method...>(key, std::move(f), std::forward<Aspects>(asps)...);
+    } else if constexpr (detail::is_awaitable_v<return_type>) {
         coro_http_handler_type f =
             std::bind(handler, &owner, std::placeholders::_1, std::placeholders::_2);
         set_http_handler<method...>(key, std::move(f), std::forward<Aspects>(asps)...);
@@ -139,6 +189,8 @@ template<typename Func, typename... Aspects>
 void
 router::set_default_handler(Func&& handler, Aspects&&... asps)
 {
+    static_assert(!detail::is_stream_handler_v<Func>,
+                  "the default handler gets a fully read body");
     auto coro_handler = detail::create_router_coro_http_handler(
         std::move(handler), std::forward<Aspects>(asps)...);
     this->set_default_handler_impl(std::move(coro_handler));
@@ -148,6 +200,8 @@ template<typename Func, typename... Aspects>
 void
 router::set_file_request_handler(Func&& handler, Aspects&&... asps)
 {
+    static_assert(!detail::is_stream_handler_v<Func>,
+                  "the file request handler gets a fully read body");
     auto coro_handler = detail::create_router_coro_http_handler(
         std::move(handler), std::forward<Aspects>(asps)...);
     set_file_request_handler_impl(std::move(coro_handler));
@@ -1,5 +1,7 @@
 #pragma once
 #include "config.hpp"
+#include "buffer_stats.hpp"
+#include "tls_stats.hpp"
 #include "websocket_conn.hpp"
 #include <boost/asio/any_io_executor.hpp>
 #include <boost/asio/socket_base.hpp>
@@ -15,8 +17,18 @@ class server {
 public:
     struct setting;
 
+    enum class io_model
+    {
+        // all threads share one io context and one acceptor
+        shared_pool,
+        // one io context, thread and SO_REUSEPORT acceptor per thread, sessions never
+        // leave the shard that accepted them
+        shard_per_core
+    };
+
 public:
-    explicit server(uint32_t num_threads = std::thread::hardware_concurrency());
+    explicit server(uint32_t num_threads = std::thread::hardware_concurrency(),
+                    io_model model = io_model::shared_pool);
     ~server();
 
     net::any_io_executor get_executor() noexcept;
@@ -32,6 +44,13 @@ public:
     void wait();
     void stop();
 
+    // number of live connections, cheap enough to poll from metrics
+    std::size_t connection_count() const noexcept;
+    // full versus resumed TLS handshakes since the server started
+    tls_handshake_stats tls_stats() const noexcept;
+    // buffers lent to CONNECT tunnels, shared by every server in the process
+    buffer_pool_stats buffer_stats() const noexcept;
+
     httplib::router& router();
 
 private:
@@ -1,5 +1,11 @@
 #pragma once
 #include "httplib/server.hpp"
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace httplib {
 
@@ -10,9 +16,68 @@ struct server::setting {
         std::string passwd;
     };
 
+    // When and how responses are compressed
+    struct compression_policy {
+        bool enabled = true;
+        // offered in this order when the client's q-values tie
+        std::vector<std::string> encodings = {"br", "zstd", "gzip", "deflate"};
+        // bodies known to be smaller go out as they are
+        std::uint64_t min_size = 1024;
+        // Content-Type prefixes worth compressing, compared case-insensitively
+        std::vector<std::string> mime_types = {"text/",
+                                               "application/json",
+                                               "application/javascript",
+                                               "application/xml",
+                                               "application/xhtml+xml",
+                                               "application/wasm",
+                                               "application/manifest+json",
+                                               "image/svg+xml",
+                                               "image/x-icon",
+                                               "font/ttf",
+                                               "font/otf"};
+        // formats that are compressed already, skipped even when mime_types matches
+        std::vector<std::string> compressed_mime_types = {"image/jpeg",
+                                                          "image/png",
+                                                          "image/gif",
+                                                          "image/webp",
+                                                          "image/avif",
+                                                          "video/",
+                                                          "audio/",
+                                                          "font/woff",
+                                                          "application/zip",
+                                                          "application/gzip",
+                                                          "application/x-7z-compressed",
+                                                          "application/zstd"};
+        // level per encoding, e.g. {"br", 5}; missing ones use the library default
+        std::unordered_map<std::string, int> levels = {{"br", 5}};
+
+        int level(std::string_view encoding) const;
+        bool is_compressible(std::string_view content_type,
+                             std::optional<std::uint64_t> size) const;
+    };
+
     std::optional<SSLConfig> ssl_conf;
     std::chrono::steady_clock::duration read_timeout = std::chrono::seconds(30);
     std::chrono::steady_clock::duration write_timeout = std::chrono::seconds(30);
+    // outbound connects of CONNECT tunnels, attempts over the resolved addresses start
+    // `connect_attempt_delay` apart (RFC 8305)
+    std::chrono::steady_clock::duration connect_timeout = std::chrono::seconds(10);
+    std::chrono::steady_clock::duration connect_attempt_delay =
+        std::chrono::milliseconds(250);
+    // largest request body accepted by any route, see httplib::body_limit for per-route
+    // limits
+    std::uint64_t max_body_size = std::numeric_limits<std::uint64_t>::max();
+    compression_policy compression;
+    // bytes of compressed static files and directory listings kept in memory, 0 turns
+    // the cache off
+    std::size_t compressed_cache_size = 0;
+    // larger files are compressed while they are sent instead
+    std::uint64_t compressed_cache_max_file_size = 256 * 1024;
+    // static files whose stat and open descriptor are kept, mind the process's
+    // descriptor limit; a cached stat is trusted for `file_cache_ttl`. Process wide,
+    // applied when the server starts running.
+    std::size_t file_cache_size = 256;
+    std::chrono::steady_clock::duration file_cache_ttl = std::chrono::seconds(2);
 
     websocket_conn::message_handler_type websocket_message_handler;
     websocket_conn::open_handler_type websocket_open_handler;
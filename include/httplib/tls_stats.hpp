@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+namespace httplib {
+
+struct tls_handshake_stats {
+    // handshakes that negotiated a new session
+    std::uint64_t full = 0;
+    // abbreviated handshakes that resumed a session from a ticket or the session cache
+    std::uint64_t resumed = 0;
+};
+
+} // namespace httplib
@@ -64,8 +64,10 @@ class any_body::writer::impl {
 public:
     explicit impl(http::fields& header, any_body::value_type& body)
         : proxy_(create_proxy_writer(header, body)) {
-        compressor_ =
-            compressor_factory::instance().create(header[http::field::content_encoding]);
+        if (!body.is_encoded()) {
+            compressor_ = compressor_factory::instance().create(
+                header[http::field::content_encoding], body.compression_level());
+        }
     }
     void init(boost::system::error_code& ec) {
         if (compressor_) compressor_->init(compressor::mode::encode);
@@ -111,7 +113,7 @@ private:
 
 private:
     std::unique_ptr<detail::proxy_writer> proxy_;
-    std::unique_ptr<compressor> compressor_;
+    compressor_ptr compressor_;
 };
 
 class any_body::reader::impl {
@@ -175,7 +177,7 @@ private:
 
 private:
     std::unique_ptr<detail::proxy_reader> proxy_;
-    std::unique_ptr<compressor> compressor_;
+    compressor_ptr compressor_;
 };
 
 any_body::writer::writer(http::fields& h, value_type& b)
@@ -1,127 +1,368 @@
 #include "compressor.hpp"
 
+#include "httplib/util/misc.hpp"
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
 #ifdef HTTPLIB_ENABLED_COMPRESS
-#include "brotli.hpp"
-#include <boost/asio/streambuf.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
-#include <boost/iostreams/filter/zlib.hpp>
-#include <boost/iostreams/filter/zstd.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#include <zlib.h>
+#include <zstd.h>
 #endif
 
 namespace httplib::body {
 #ifdef HTTPLIB_ENABLED_COMPRESS
-namespace io = boost::iostreams;
 
+// Output side shared by the codecs below. The output buffer only grows, so a
+// compressor recycled through the pool compresses the next message without
+// allocating.
 class basic_compressor : public compressor {
 public:
-    explicit basic_compressor() { }
-
     void
-    init(mode m)
+    init(mode m) override
     {
-        init_filtering_ostreambuf(m, stream_);
-        stream_.push(buffer_);
+        consume_all();
+        finished_ = false;
+        reset(m);
+        mode_ = m;
     }
 
     net::const_buffer
-    buffer() const
+    buffer() const override
     {
-        return buffer_.data();
+        return {out_.data() + begin_, end_ - begin_};
     }
     void
-    write(const net::const_buffer& buffer, bool more = true)
+    write(const net::const_buffer& buffer, bool more = true) override
     {
-        io::write(stream_, (const char*)buffer.data(), buffer.size());
-        if (!more) { io::close(stream_); }
+        if (finished_) return;
+        finished_ = !more;
+        process(buffer, !more);
     }
     void
-    finish()
+    finish() override
     {
-        io::close(stream_);
+        if (finished_) return;
+        finished_ = true;
+        process({}, true);
     }
     void
-    consume_all()
+    consume_all() override
     {
-        buffer_.consume(buffer_.size());
+        begin_ = end_ = 0;
     }
     void
-    consume(std::size_t bytes)
+    consume(std::size_t bytes) override
     {
-        buffer_.consume(bytes);
+        begin_ = std::min(begin_ + bytes, end_);
+        if (begin_ == end_) consume_all();
+    }
+    void
+    shrink(std::size_t max_bytes) override
+    {
+        if (out_.capacity() <= max_bytes) return;
+        std::vector<char>().swap(out_);
+        begin_ = end_ = 0;
     }
 
 protected:
+    static constexpr std::size_t chunk_size = 16 * 1024;
+
+    // restarts the codec for a message in mode `m`, mode_ still holds the previous one
+    virtual void
+    reset(mode m) = 0;
+    // runs `in` through the codec, `last` ends the message
     virtual void
-    init_filtering_ostreambuf(mode m, io::filtering_ostreambuf& stream) = 0;
+    process(net::const_buffer in, bool last) = 0;
+
+    // room for at least chunk_size more output bytes
+    std::pair<char*, std::size_t>
+    prepare()
+    {
+        if (out_.size() - end_ < chunk_size && begin_ != 0) {
+            std::memmove(out_.data(), out_.data() + begin_, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        if (out_.size() - end_ < chunk_size)
+            out_.resize(std::max(out_.size() * 2, end_ + chunk_size));
+        return {out_.data() + end_, out_.size() - end_};
+    }
+    void
+    commit(std::size_t bytes)
+    {
+        end_ += bytes;
+    }
+
+    mode mode_ = mode::encode;
 
 private:
-    net::streambuf buffer_;
-    io::filtering_ostreambuf stream_;
+    std::vector<char> out_;
+    std::size_t begin_ = 0;
+    std::size_t end_   = 0;
+    bool finished_     = false;
 };
 
-class gzip_compressor_adapter : public basic_compressor {
+// deflate streams, zlib wrapped for "deflate" and gzip wrapped for "gzip"
+class zlib_compressor : public basic_compressor {
+public:
+    zlib_compressor(int window_bits, int level) : window_bits_(window_bits), level_(level)
+    {
+    }
+    ~zlib_compressor() override
+    {
+        end();
+    }
+
 protected:
     void
-    init_filtering_ostreambuf(mode m, io::filtering_ostreambuf& stream) override
+    reset(mode m) override
     {
-        switch (m) {
-            case mode::encode: stream.push(io::gzip_compressor()); break;
-            case mode::decode: stream.push(io::gzip_decompressor()); break;
-            default: break;
+        if (started_ && m == mode_) {
+            int ret = m == mode::encode ? deflateReset(&stream_) : inflateReset(&stream_);
+            if (ret == Z_OK) return;
         }
+        end();
+        stream_ = {};
+        int ret = m == mode::encode
+                      ? deflateInit2(&stream_,
+                                     level_ < 0 ? Z_DEFAULT_COMPRESSION : level_,
+                                     Z_DEFLATED,
+                                     window_bits_,
+                                     8,
+                                     Z_DEFAULT_STRATEGY)
+                      : inflateInit2(&stream_, window_bits_);
+        if (ret != Z_OK) throw std::runtime_error("zlib initialization failed");
+        started_ = true;
     }
-};
-class zlib_compressor_adapter : public basic_compressor {
-protected:
     void
-    init_filtering_ostreambuf(mode m, io::filtering_ostreambuf& stream) override
+    process(net::const_buffer in, bool last) override
     {
-        switch (m) {
-            case mode::encode: stream.push(io::zlib_compressor()); break;
-            case mode::decode: stream.push(io::zlib_decompressor()); break;
-            default: break;
+        const bool encode = mode_ == mode::encode;
+        stream_.next_in   = static_cast<Bytef*>(const_cast<void*>(in.data()));
+        stream_.avail_in  = static_cast<uInt>(in.size());
+        for (;;) {
+            auto [out, size]  = prepare();
+            stream_.next_out  = reinterpret_cast<Bytef*>(out);
+            stream_.avail_out = static_cast<uInt>(size);
+
+            int ret = encode ? deflate(&stream_, last ? Z_FINISH : Z_NO_FLUSH)
+                             : inflate(&stream_, Z_NO_FLUSH);
+            commit(size - stream_.avail_out);
+            if (ret == Z_STREAM_END) return;
+            if (ret != Z_OK && ret != Z_BUF_ERROR)
+                throw std::runtime_error(encode ? "zlib compression failed"
+                                                : "zlib decompression failed");
+            // all input taken and room left over, the codec holds nothing back
+            bool drained = stream_.avail_in == 0 && stream_.avail_out != 0;
+            if (drained && !(encode && last)) return;
         }
     }
+
+private:
+    void
+    end()
+    {
+        if (!started_) return;
+        mode_ == mode::encode ? deflateEnd(&stream_) : inflateEnd(&stream_);
+        started_ = false;
+    }
+
+    z_stream stream_ {};
+    int window_bits_;
+    int level_;
+    bool started_ = false;
 };
-class zstd_compressor_adapter : public basic_compressor {
+
+class zstd_compressor : public basic_compressor {
+public:
+    explicit zstd_compressor(int level) : level_(level) { }
+    ~zstd_compressor() override
+    {
+        ZSTD_freeCCtx(cctx_);
+        ZSTD_freeDCtx(dctx_);
+    }
+
 protected:
     void
-    init_filtering_ostreambuf(mode m, io::filtering_ostreambuf& stream) override
+    reset(mode m) override
     {
-        switch (m) {
-            case mode::encode: stream.push(io::zstd_compressor()); break;
-            case mode::decode: stream.push(io::zstd_decompressor()); break;
-            default: break;
+        if (m == mode::encode) {
+            if (!cctx_) cctx_ = ZSTD_createCCtx();
+            if (!cctx_) throw std::runtime_error("zstd initialization failed");
+            ZSTD_CCtx_reset(cctx_, ZSTD_reset_session_only);
+            ZSTD_CCtx_setParameter(cctx_,
+                                   ZSTD_c_compressionLevel,
+                                   level_ < 0 ? ZSTD_CLEVEL_DEFAULT : level_);
+        } else {
+            if (!dctx_) dctx_ = ZSTD_createDCtx();
+            if (!dctx_) throw std::runtime_error("zstd initialization failed");
+            ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_only);
         }
     }
+    void
+    process(net::const_buffer in, bool last) override
+    {
+        const bool encode = mode_ == mode::encode;
+        ZSTD_inBuffer input {in.data(), in.size(), 0};
+        for (;;) {
+            auto [out, size] = prepare();
+            ZSTD_outBuffer output {out, size, 0};
+
+            auto directive = last ? ZSTD_e_end : ZSTD_e_continue;
+            auto ret = encode ? ZSTD_compressStream2(cctx_, &output, &input, directive)
+                              : ZSTD_decompressStream(dctx_, &output, &input);
+            if (ZSTD_isError(ret)) throw std::runtime_error(ZSTD_getErrorName(ret));
+            commit(output.pos);
+
+            // ZSTD_e_end returns how much is still to be flushed
+            if (encode && last) {
+                if (ret == 0) return;
+            } else if (input.pos == input.size && output.pos < output.size) {
+                return;
+            }
+        }
+    }
+
+private:
+    ZSTD_CCtx* cctx_ = nullptr;
+    ZSTD_DCtx* dctx_ = nullptr;
+    int level_;
 };
-class brotli_compressor_adapter : public basic_compressor {
+
+// Brotli states cannot be reset, they are created per message; the pool still saves
+// the output buffer.
+class brotli_compressor : public basic_compressor {
+public:
+    static constexpr int default_quality = 6;
+
+    explicit brotli_compressor(int level) : level_(level) { }
+
 protected:
     void
-    init_filtering_ostreambuf(mode m, io::filtering_ostreambuf& stream) override
+    reset(mode m) override
+    {
+        encoder_.reset();
+        decoder_.reset();
+        if (m == mode::encode) {
+            encoder_.reset(BrotliEncoderCreateInstance(nullptr, nullptr, nullptr));
+            if (!encoder_) throw std::runtime_error("brotli initialization failed");
+            BrotliEncoderSetParameter(encoder_.get(),
+                                      BROTLI_PARAM_QUALITY,
+                                      level_ < 0 ? default_quality : level_);
+        } else {
+            decoder_.reset(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr));
+            if (!decoder_) throw std::runtime_error("brotli initialization failed");
+        }
+    }
+    void
+    process(net::const_buffer in, bool last) override
     {
-        switch (m) {
-            case mode::encode: stream.push(brotli_compressor()); break;
-            case mode::decode: stream.push(brotli_decompressor()); break;
-            default: break;
+        auto next_in        = static_cast<const std::uint8_t*>(in.data());
+        std::size_t avail_in = in.size();
+        for (;;) {
+            auto [out, size]      = prepare();
+            auto next_out         = reinterpret_cast<std::uint8_t*>(out);
+            std::size_t avail_out = size;
+
+            if (mode_ == mode::encode) {
+                auto op = last ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+                if (!BrotliEncoderCompressStream(encoder_.get(),
+                                                 op,
+                                                 &avail_in,
+                                                 &next_in,
+                                                 &avail_out,
+                                                 &next_out,
+                                                 nullptr))
+                    throw std::runtime_error("brotli compression failed");
+                commit(size - avail_out);
+
+                if (last ? BrotliEncoderIsFinished(encoder_.get())
+                         : avail_in == 0 && !BrotliEncoderHasMoreOutput(encoder_.get()))
+                    return;
+            } else {
+                auto result = BrotliDecoderDecompressStream(
+                    decoder_.get(), &avail_in, &next_in, &avail_out, &next_out, nullptr);
+                commit(size - avail_out);
+
+                if (result == BROTLI_DECODER_RESULT_ERROR)
+                    throw std::runtime_error("brotli decompression failed");
+                if (result != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) return;
+            }
         }
     }
+
+private:
+    std::unique_ptr<BrotliEncoderState, decltype(&BrotliEncoderDestroyInstance)>
+        encoder_ {nullptr, &BrotliEncoderDestroyInstance};
+    std::unique_ptr<BrotliDecoderState, decltype(&BrotliDecoderDestroyInstance)>
+        decoder_ {nullptr, &BrotliDecoderDestroyInstance};
+    int level_;
 };
 
 #endif
 
+namespace {
+// idle compressors of one thread, by encoding and level
+struct compressor_pool {
+    struct slot {
+        std::string encoding;
+        int level = -1;
+        std::vector<std::unique_ptr<compressor>> idle;
+    };
+
+    ~compressor_pool()
+    {
+        destroyed = true;
+    }
+
+    slot&
+    find(const std::string& encoding, int level)
+    {
+        for (auto& s : slots) {
+            if (s.level == level && s.encoding == encoding) return s;
+        }
+        return slots.emplace_back(slot {encoding, level, {}});
+    }
+
+    // compressors released while the thread exits are deleted instead
+    static compressor_pool*
+    local()
+    {
+        if (destroyed) return nullptr;
+        thread_local compressor_pool pool;
+        return &pool;
+    }
+
+    std::vector<slot> slots;
+    static inline thread_local bool destroyed = false;
+};
+} // namespace
+
+void
+compressor_deleter::operator()(compressor* c) const noexcept
+{
+    compressor_factory::instance().release(c);
+}
+
 compressor_factory::compressor_factory()
 {
 #ifdef HTTPLIB_ENABLED_COMPRESS
-    register_compressor("gzip",
-                        []() { return std::make_unique<gzip_compressor_adapter>(); });
-    register_compressor("deflate",
-                        []() { return std::make_unique<zlib_compressor_adapter>(); });
-    register_compressor("zstd",
-                        []() { return std::make_unique<zstd_compressor_adapter>(); });
-    register_compressor("br",
-                        []() { return std::make_unique<brotli_compressor_adapter>(); });
+    register_compressor("gzip", [](int level) {
+        return std::make_unique<zlib_compressor>(MAX_WBITS + 16, level);
+    });
+    register_compressor("deflate", [](int level) {
+        return std::make_unique<zlib_compressor>(MAX_WBITS, level);
+    });
+    register_compressor(
+        "zstd", [](int level) { return std::make_unique<zstd_compressor>(level); });
+    register_compressor(
+        "br", [](int level) { return std::make_unique<brotli_compressor>(level); });
 #endif
 }
 compressor_factory&
@@ -150,12 +391,43 @@ compressor_factory::register_compressor(const std::string& encoding,
     creators_[encoding] = std::move(func);
 }
 
-std::unique_ptr<httplib::body::compressor>
-compressor_factory::create(const std::string& encoding)
+compressor_ptr
+compressor_factory::create(const std::string& encoding, int level /*= -1*/)
 {
+    // the encoding may come straight from a request header, unknown ones must not
+    // reach the pool
     auto iter = creators_.find(encoding);
     if (iter == creators_.end()) return nullptr;
-    return iter->second();
+
+    if (auto pool = compressor_pool::local()) {
+        auto& idle = pool->find(encoding, level).idle;
+        if (!idle.empty()) {
+            compressor_ptr c(idle.back().release());
+            idle.pop_back();
+            return c;
+        }
+    }
+
+    auto c       = iter->second(level);
+    c->encoding_ = encoding;
+    c->level_    = level;
+    return compressor_ptr(c.release());
+}
+
+void
+compressor_factory::release(compressor* c) noexcept
+{
+    if (!c) return;
+    std::unique_ptr<compressor> owned(c);
+    auto pool = compressor_pool::local();
+    if (!pool) return;
+
+    try {
+        c->shrink(max_pooled_buffer);
+        auto& idle = pool->find(c->encoding_, c->level_).idle;
+        if (idle.size() < pool_size) idle.push_back(std::move(owned));
+    } catch (...) {
+    }
 }
 
 bool
@@ -165,4 +437,63 @@ compressor_factory::is_supported_encoding(std::string_view encoding) const
     return iter != creators_.end();
 }
 
+float
+accept_encoding_weight(std::string_view accept, std::string_view coding)
+{
+    std::optional<float> wildcard;
+    for (auto item : util::split(accept, ",")) {
+        auto params = item.find(';');
+        auto name   = boost::trim_copy(item.substr(0, params));
+
+        float q = 1;
+        while (params != std::string_view::npos) {
+            auto next  = item.find(';', params + 1);
+            auto param = boost::trim_copy(item.substr(params + 1, next - params - 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') &&
+                param[1] == '=') {
+                auto value  = param.substr(2);
+                auto last   = value.data() + value.size();
+                auto result = std::from_chars(value.data(), last, q);
+                if (result.ec != std::errc {}) q = 0;
+            }
+            params = next;
+        }
+
+        if (boost::iequals(name, coding)) return std::clamp(q, 0.f, 1.f);
+        if (name == "*") wildcard = std::clamp(q, 0.f, 1.f);
+    }
+    return wildcard.value_or(0);
+}
+
+std::string_view
+negotiate_encoding(std::string_view accept, const std::vector<std::string>& offered)
+{
+    if (accept.empty()) return {};
+
+    auto& factory = compressor_factory::instance();
+    std::string_view best;
+    float best_weight = 0;
+    for (const auto& encoding : offered) {
+        if (!factory.is_supported_encoding(encoding)) continue;
+        auto weight = accept_encoding_weight(accept, encoding);
+        if (weight > best_weight) {
+            best        = encoding;
+            best_weight = weight;
+        }
+    }
+    return best;
+}
+
+bool
+compress(const std::string& encoding, int level, std::string_view data, std::string& out)
+{
+    auto compressor = compressor_factory::instance().create(encoding, level);
+    if (!compressor) return false;
+    compressor->init(compressor::mode::encode);
+    compressor->write(net::buffer(data), false);
+    auto buffer = compressor->buffer();
+    out.assign(static_cast<const char*>(buffer.data()), buffer.size());
+    return true;
+}
+
 } // namespace httplib::body
\ No newline at end of file
@@ -2,7 +2,11 @@
 #include "httplib/config.hpp"
 #include <boost/asio/buffer.hpp>
 #include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace httplib::body {
 class compressor {
@@ -12,6 +16,7 @@ public:
         decode,
     };
     virtual ~compressor() = default;
+    // starts a message, a recycled compressor keeps its codec state and buffers
     virtual void
     init(mode m) = 0;
 
@@ -25,17 +30,44 @@ public:
     consume_all() = 0;
     virtual void
     consume(std::size_t bytes) = 0;
+    // frees output buffers grown past `max_bytes`, called before the compressor is
+    // pooled so that one huge message does not pin its memory
+    virtual void
+    shrink(std::size_t max_bytes)
+    {
+    }
+
+private:
+    friend class compressor_factory;
+    // the pool a released compressor goes back to
+    std::string encoding_;
+    int level_ = -1;
 };
 
+// hands the compressor back to compressor_factory instead of deleting it
+struct compressor_deleter {
+    void
+    operator()(compressor* c) const noexcept;
+};
+using compressor_ptr = std::unique_ptr<compressor, compressor_deleter>;
+
 class compressor_factory {
 public:
-    using create_function = std::function<std::unique_ptr<compressor>()>;
+    // -1 selects the library's default level
+    using create_function = std::function<std::unique_ptr<compressor>(int level)>;
+
+    // idle compressors kept per thread, encoding and level
+    static constexpr std::size_t pool_size = 4;
+    // output buffer a pooled compressor may keep
+    static constexpr std::size_t max_pooled_buffer = 256 * 1024;
 
     const std::vector<std::string>&
     supported_encoding() const;
 
-    std::unique_ptr<compressor>
-    create(const std::string& encoding);
+    // Reuses an idle compressor of the calling thread when there is one. Released
+    // compressors return to the pool of the thread releasing them.
+    compressor_ptr
+    create(const std::string& encoding, int level = -1);
 
     bool
     is_supported_encoding(std::string_view encoding) const;
@@ -45,9 +77,28 @@ public:
     instance();
 
 private:
+    friend struct compressor_deleter;
+
     compressor_factory();
     void
     register_compressor(const std::string& encoding, create_function&& func);
+    void
+    release(compressor* c) noexcept;
+
     std::unordered_map<std::string, create_function> creators_;
 };
+
+// q-value an Accept-Encoding value gives `coding`, by name or through "*"; 0 when it
+// is refused or not listed at all
+float
+accept_encoding_weight(std::string_view accept, std::string_view coding);
+
+// the supported encoding out of `offered` the client weighs highest, earlier entries
+// win ties; empty when none is acceptable
+std::string_view
+negotiate_encoding(std::string_view accept, const std::vector<std::string>& offered);
+
+// compresses `data` in one go into `out`, false if `encoding` is not supported
+bool
+compress(const std::string& encoding, int level, std::string_view data, std::string& out);
 } // namespace httplib::body
\ No newline at end of file
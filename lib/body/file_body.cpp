@@ -1,6 +1,64 @@
 #include "httplib/body/file_body.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
 namespace httplib::body {
 
+std::shared_ptr<const shared_file>
+shared_file::open(const fs::path& path, boost::system::error_code& ec)
+{
+    auto file = std::make_shared<shared_file>();
+    auto u8path = path.u8string();
+    file->file_.open(
+        reinterpret_cast<const char*>(u8path.c_str()), beast::file_mode::scan, ec);
+    if (ec) return nullptr;
+    file->size_ = file->file_.size(ec);
+    if (ec) return nullptr;
+    return file;
+}
+
+std::size_t
+shared_file::read_at(std::uint64_t offset,
+                     void* buffer,
+                     std::size_t n,
+                     boost::system::error_code& ec) const
+{
+#ifdef _WIN32
+    OVERLAPPED overlapped {};
+    overlapped.Offset     = static_cast<DWORD>(offset);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD bytes           = 0;
+    auto count = static_cast<DWORD>((std::min)(n, std::size_t(0xffffffff)));
+    if (!::ReadFile(file_.native_handle(), buffer, count, &bytes, &overlapped)) {
+        auto error = ::GetLastError();
+        if (error != ERROR_HANDLE_EOF) {
+            ec.assign(error, boost::system::system_category());
+            return 0;
+        }
+    }
+    ec = {};
+    return bytes;
+#else
+    for (;;) {
+        auto bytes =
+            ::pread(file_.native_handle(), buffer, n, static_cast<off_t>(offset));
+        if (bytes >= 0) {
+            ec = {};
+            return static_cast<std::size_t>(bytes);
+        }
+        if (errno != EINTR) {
+            ec.assign(errno, boost::system::system_category());
+            return 0;
+        }
+    }
+#endif
+}
+
 file_body::writer::writer(const http::fields&, value_type& b) : body_(b) { }
 
 void
@@ -21,17 +79,14 @@ file_body::writer::get(boost::system::error_code& ec)
             range.second = range.second + 1;
         }
 
-        if (!pos_) {
-            pos_ = range.first;
-            body_.seekg(*pos_);
-        }
+        if (!pos_) pos_ = range.first;
         std::size_t const n =
             (std::min)(sizeof(buf_), beast::detail::clamp(range.second - *pos_));
         if (n == 0) {
             ec = {};
             return boost::none;
         }
-        auto const nread = body_.read(buf_, n);
+        auto const nread = body_.read_at(*pos_, buf_, n);
         if (nread == 0) {
             ec = http::error::short_read;
             return boost::none;
@@ -61,7 +116,7 @@ file_body::writer::get(boost::system::error_code& ec)
             header += fmt::format("Content-Range: bytes {}-{}/{}\r\n",
                                   range.first,
                                   range.second,
-                                  file_size_);
+                                  body_.file_size());
             header += "\r\n";
             strcpy(buf_, header.c_str());
             step_ = step::content;
@@ -69,17 +124,15 @@ file_body::writer::get(boost::system::error_code& ec)
             return {{{buf_, header.size()}, true}};
         } break;
         case step::content: {
-            if (!pos_) {
-                pos_ = range.first;
-                body_.seekg(*pos_);
-            }
+            if (!pos_) pos_ = range.first;
+            // ranges are inclusive, the last byte is part of the range
             std::size_t const n =
-                (std::min)(sizeof(buf_), beast::detail::clamp(range.second - *pos_));
+                (std::min)(sizeof(buf_), beast::detail::clamp(range.second + 1 - *pos_));
             if (n == 0) {
                 step_ = step::content_end;
                 return get(ec);
             }
-            auto const nread = body_.read(buf_, n);
+            auto const nread = body_.read_at(*pos_, buf_, n);
             if (nread == 0) {
                 ec = http::error::short_read;
                 return boost::none;
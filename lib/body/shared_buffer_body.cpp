@@ -0,0 +1,41 @@
+#include "httplib/body/shared_buffer_body.hpp"
+
+#include <boost/beast/http/error.hpp>
+
+namespace httplib::body {
+
+shared_buffer_body::reader::reader(const http::fields&, value_type&) { }
+
+void
+shared_buffer_body::reader::init(boost::optional<std::uint64_t> const&,
+                                 beast::error_code& ec)
+{
+    ec = {};
+}
+
+std::size_t
+shared_buffer_body::reader::put(net::const_buffer const&, beast::error_code& ec)
+{
+    ec = http::error::unexpected_body;
+    return 0;
+}
+
+void
+shared_buffer_body::reader::finish(beast::error_code& ec)
+{
+    ec = {};
+}
+
+shared_buffer_body::writer::writer(const http::fields&, value_type const& b) : body_(b)
+{
+}
+
+boost::optional<std::pair<shared_buffer_body::writer::const_buffers_type, bool>>
+shared_buffer_body::writer::get(beast::error_code& ec)
+{
+    ec = {};
+    if (!body_.data) return boost::none;
+    return {{const_buffers_type {body_.data->data(), body_.data->size()}, false}};
+}
+
+} // namespace httplib::body
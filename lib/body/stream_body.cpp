@@ -0,0 +1,43 @@
+#include "httplib/body/stream_body.hpp"
+
+#include <boost/beast/http/error.hpp>
+
+namespace httplib::body {
+
+stream_body::reader::reader(const http::fields&, value_type&) { }
+
+void
+stream_body::reader::init(boost::optional<std::uint64_t> const&, beast::error_code& ec)
+{
+    ec = {};
+}
+
+std::size_t
+stream_body::reader::put(net::const_buffer const&, beast::error_code& ec)
+{
+    ec = http::error::unexpected_body;
+    return 0;
+}
+
+void
+stream_body::reader::finish(beast::error_code& ec)
+{
+    ec = {};
+}
+
+stream_body::writer::writer(const http::fields&, value_type const&) { }
+
+void
+stream_body::writer::init(beast::error_code& ec)
+{
+    ec = {};
+}
+
+boost::optional<std::pair<stream_body::writer::const_buffers_type, bool>>
+stream_body::writer::get(beast::error_code& ec)
+{
+    ec = net::error::operation_not_supported;
+    return boost::none;
+}
+
+} // namespace httplib::body
@@ -0,0 +1,22 @@
+#include "httplib/body_reader.hpp"
+
+#include <boost/beast/http/error.hpp>
+
+namespace httplib {
+
+net::awaitable<void> body_reader::async_read_all(std::string& out,
+                                                 std::size_t max_size,
+                                                 boost::system::error_code& ec) {
+    char buf[16 * 1024];
+    while (!is_done()) {
+        auto n = co_await async_read_some(net::buffer(buf), ec);
+        if (ec) co_return;
+        if (out.size() + n > max_size) {
+            ec = http::error::body_limit;
+            co_return;
+        }
+        out.append(buf, n);
+    }
+}
+
+} // namespace httplib
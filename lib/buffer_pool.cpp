@@ -0,0 +1,133 @@
+#include "buffer_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace httplib {
+
+namespace {
+constexpr std::size_t class_count =
+    std::countr_zero(buffer_pool::max_size) - std::countr_zero(buffer_pool::min_size) + 1;
+
+std::size_t size_class(std::size_t size) {
+    return std::countr_zero(size) - std::countr_zero(buffer_pool::min_size);
+}
+
+struct counters {
+    std::atomic<std::size_t> buffers_in_use {0};
+    std::atomic<std::size_t> bytes_in_use {0};
+    std::atomic<std::size_t> idle_buffers {0};
+    std::atomic<std::size_t> idle_bytes {0};
+    std::atomic<std::uint64_t> hits {0};
+    std::atomic<std::uint64_t> misses {0};
+};
+counters& global_counters() {
+    static counters c;
+    return c;
+}
+
+// idle buffers of one thread, per size class
+struct local_pool {
+    ~local_pool() {
+        destroyed = true;
+        auto& c = global_counters();
+        for (auto& idle : classes) {
+            for (auto& b : idle)
+                delete[] b;
+        }
+        c.idle_buffers -= buffers;
+        c.idle_bytes -= bytes;
+    }
+
+    // buffers released while the thread exits are freed right away
+    static local_pool* get() {
+        if (destroyed) return nullptr;
+        thread_local local_pool pool;
+        return &pool;
+    }
+
+    std::array<std::vector<std::uint8_t*>, class_count> classes;
+    std::size_t buffers = 0;
+    std::size_t bytes = 0;
+    static inline thread_local bool destroyed = false;
+};
+} // namespace
+
+buffer_pool::buffer::buffer(buffer&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) { }
+
+buffer_pool::buffer& buffer_pool::buffer::operator=(buffer&& other) noexcept {
+    if (this != &other) {
+        buffer_pool::release(data_, size_);
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+buffer_pool::buffer::~buffer() { buffer_pool::release(data_, size_); }
+
+buffer_pool::buffer buffer_pool::acquire(std::size_t size) {
+    size = std::bit_ceil(std::clamp(size, min_size, max_size));
+    auto& c = global_counters();
+    c.buffers_in_use++;
+    c.bytes_in_use += size;
+
+    if (auto pool = local_pool::get()) {
+        auto& idle = pool->classes[size_class(size)];
+        if (!idle.empty()) {
+            auto data = idle.back();
+            idle.pop_back();
+            pool->buffers--;
+            pool->bytes -= size;
+            c.idle_buffers--;
+            c.idle_bytes -= size;
+            c.hits++;
+            return buffer(data, size);
+        }
+    }
+    c.misses++;
+    return buffer(new std::uint8_t[size], size);
+}
+
+void buffer_pool::release(std::uint8_t* data, std::size_t size) noexcept {
+    if (!data) return;
+    auto& c = global_counters();
+    c.buffers_in_use--;
+    c.bytes_in_use -= size;
+
+    auto pool = local_pool::get();
+    if (!pool || pool->bytes + size > max_idle_bytes) {
+        delete[] data;
+        return;
+    }
+    try {
+        pool->classes[size_class(size)].push_back(data);
+    } catch (...) {
+        delete[] data;
+        return;
+    }
+    pool->buffers++;
+    pool->bytes += size;
+    c.idle_buffers++;
+    c.idle_bytes += size;
+}
+
+buffer_pool_stats buffer_pool::stats() noexcept {
+    auto& c = global_counters();
+    buffer_pool_stats result;
+    result.buffers_in_use = c.buffers_in_use;
+    result.bytes_in_use = c.bytes_in_use;
+    result.idle_buffers = c.idle_buffers;
+    result.idle_bytes = c.idle_bytes;
+    result.hits = c.hits;
+    result.misses = c.misses;
+    return result;
+}
+
+} // namespace httplib
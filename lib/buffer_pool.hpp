@@ -0,0 +1,49 @@
+#pragma once
+#include "httplib/buffer_stats.hpp"
+#include "httplib/config.hpp"
+#include <boost/asio/buffer.hpp>
+#include <cstddef>
+#include <cstdint>
+
+namespace httplib {
+
+// Buffers lent to an I/O loop for a single read and the write that follows.
+//
+// Sizes are powers of two from min_size to max_size. Released buffers go back to the
+// pool of the releasing thread, which keeps up to max_idle_bytes of them and frees the
+// rest, so memory follows the traffic in flight rather than the number of connections.
+class buffer_pool {
+public:
+    static constexpr std::size_t min_size = 4 * 1024;
+    static constexpr std::size_t max_size = 512 * 1024;
+    static constexpr std::size_t max_idle_bytes = 4 * 1024 * 1024;
+
+    class buffer {
+    public:
+        buffer() = default;
+        buffer(buffer&& other) noexcept;
+        buffer& operator=(buffer&& other) noexcept;
+        ~buffer();
+
+        std::uint8_t* data() const noexcept { return data_; }
+        std::size_t size() const noexcept { return size_; }
+        net::mutable_buffer mutable_buffer() const noexcept { return {data_, size_}; }
+
+    private:
+        friend class buffer_pool;
+        buffer(std::uint8_t* data, std::size_t size) noexcept
+            : data_(data), size_(size) { }
+
+        std::uint8_t* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+
+    // at least `size` bytes, clamped to [min_size, max_size]
+    static buffer acquire(std::size_t size);
+    static buffer_pool_stats stats() noexcept;
+
+private:
+    static void release(std::uint8_t* data, std::size_t size) noexcept;
+};
+
+} // namespace httplib
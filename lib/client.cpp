@@ -1,7 +1,9 @@
 #include "httplib/client.hpp"
 
 #include "body/compressor.hpp"
+#include "httplib/dns_cache.hpp"
 #include "httplib/use_awaitable.hpp"
+#include "stream/happy_eyeballs.hpp"
 #include "stream/http_stream.hpp"
 #include <boost/algorithm/string/join.hpp>
 #include <boost/asio/co_spawn.hpp>
@@ -14,19 +16,78 @@
 #include <boost/beast/http/string_body.hpp>
 #include <boost/beast/http/write.hpp>
 #include <boost/beast/version.hpp>
+#include <mutex>
+#include <unordered_map>
 
 
 namespace httplib {
+#ifdef HTTPLIB_ENABLED_SSL
+namespace detail {
+
+// TLS state shared by every client in the process: one ssl context, because loading
+// the default verify paths is expensive, and the last session of every host so that
+// reconnects do an abbreviated handshake.
+class client_tls_sessions {
+public:
+    static constexpr std::size_t max_hosts = 1024;
+
+    static client_tls_sessions& instance() {
+        static client_tls_sessions _instance;
+        return _instance;
+    }
+
+    std::shared_ptr<ssl::context> context() const { return ssl_ctx_; }
+
+    void restore(SSL* ssl, const std::string& host_key) {
+        std::unique_lock<std::mutex> lck(mtx_);
+        auto iter = sessions_.find(host_key);
+        if (iter != sessions_.end()) SSL_set_session(ssl, iter->second.get());
+    }
+    void save(SSL* ssl, const std::string& host_key) {
+        session_ptr session(SSL_get1_session(ssl), &SSL_SESSION_free);
+        if (!session || !SSL_SESSION_is_resumable(session.get())) return;
+
+        std::unique_lock<std::mutex> lck(mtx_);
+        if (sessions_.size() >= max_hosts && !sessions_.count(host_key))
+            sessions_.erase(sessions_.begin());
+        sessions_.insert_or_assign(host_key, std::move(session));
+    }
+
+private:
+    client_tls_sessions() {
+        unsigned long ssl_options = ssl::context::default_workarounds |
+                                    ssl::context::no_sslv2 | ssl::context::single_dh_use;
+
+        ssl_ctx_ = std::make_shared<ssl::context>(ssl::context::sslv23);
+        ssl_ctx_->set_options(ssl_options);
+        ssl_ctx_->set_default_verify_paths();
+        ssl_ctx_->set_verify_mode(ssl::verify_none);
+        SSL_CTX_set_session_cache_mode(ssl_ctx_->native_handle(), SSL_SESS_CACHE_CLIENT);
+    }
+
+    using session_ptr = std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)>;
+
+    std::shared_ptr<ssl::context> ssl_ctx_;
+    std::mutex mtx_;
+    std::unordered_map<std::string, session_ptr> sessions_;
+};
+
+} // namespace detail
+#endif
+
 class client::impl {
 public:
     impl(const net::any_io_executor& ex, std::string_view host, uint16_t port)
-        : executor_(ex), resolver_(ex), host_(host), port_(port) { }
+        : executor_(ex), host_(host), port_(port) { }
 
     void set_timeout_policy(const timeout_policy& policy) { timeout_policy_ = policy; }
 
     void set_timeout(const std::chrono::steady_clock::duration& duration) {
         timeout_ = duration;
     }
+    void set_connect_attempt_delay(const std::chrono::steady_clock::duration& duration) {
+        connect_attempt_delay_ = duration;
+    }
     void set_use_ssl(bool ssl) { use_ssl_ = ssl; }
 
     client::request make_http_request(http::verb method,
@@ -53,7 +114,6 @@ public:
 
 public:
     void close() {
-        resolver_.cancel();
         if (variant_stream_) {
             variant_stream_->expires_never();
             boost::system::error_code ec;
@@ -87,32 +147,31 @@ public:
             // Set up an HTTP GET request message
             if (!is_connected()) {
                 close();
-                auto endpoints = co_await resolver_.async_resolve(
-                    host_, std::to_string(port_), net::use_awaitable);
+                boost::system::error_code resolve_ec;
+                auto endpoints = co_await dns_cache::instance().async_resolve(
+                    host_, std::to_string(port_), resolve_ec);
+                if (resolve_ec) throw boost::system::system_error(resolve_ec);
 
                 if (use_ssl_) {
 #ifdef HTTPLIB_ENABLED_SSL
-                    unsigned long ssl_options = ssl::context::default_workarounds |
-                                                ssl::context::no_sslv2 |
-                                                ssl::context::single_dh_use;
-
-                    auto ssl_ctx = std::make_shared<ssl::context>(ssl::context::sslv23);
-                    ssl_ctx->set_options(ssl_options);
-                    ssl_ctx->set_default_verify_paths();
-                    ssl_ctx->set_verify_mode(ssl::verify_none);
-
-                    ssl_http_stream stream(co_await net::this_coro::executor, ssl_ctx);
+                    auto& tls_sessions = detail::client_tls_sessions::instance();
+                    ssl_http_stream stream(co_await net::this_coro::executor,
+                                           tls_sessions.context());
                     if (!SSL_set_tlsext_host_name(stream.native_handle(),
                                                   host_.c_str())) {
                         beast::error_code ec {static_cast<int>(::ERR_get_error()),
                                               net::error::get_ssl_category()};
                         throw boost::system::system_error(ec);
                     }
+                    tls_sessions.restore(stream.native_handle(), tls_session_key());
                     expires_after(stream, true);
-                    co_await stream.next_layer().async_connect(endpoints,
-                                                               net::use_awaitable);
+                    co_await async_connect(stream.next_layer().socket(), endpoints);
                     co_await stream.async_handshake(ssl::stream_base::client,
                                                     net::use_awaitable);
+                    if (SSL_session_reused(stream.native_handle()) == 1)
+                        tls_stats_.resumed++;
+                    else
+                        tls_stats_.full++;
 
                     variant_stream_ = std::make_unique<http_variant_stream_type>(
                         ssl_http_stream(std::move(stream)));
@@ -124,7 +183,7 @@ public:
                 } else {
                     http_stream stream(co_await net::this_coro::executor);
                     expires_after(stream, true);
-                    co_await stream.async_connect(endpoints, net::use_awaitable);
+                    co_await async_connect(stream.socket(), endpoints);
                     variant_stream_ = std::make_unique<http_variant_stream_type>(
                         http_stream(std::move(stream)));
                 }
@@ -153,6 +212,13 @@ public:
             }
             resp = body_parser.release();
             variant_stream_->expires_never();
+#ifdef HTTPLIB_ENABLED_SSL
+            // TLS 1.3 tickets arrive after the handshake, save the session once the
+            // exchange is complete
+            if (auto stream = std::get_if<ssl_http_stream>(variant_stream_.get()))
+                detail::client_tls_sessions::instance().save(stream->native_handle(),
+                                                             tls_session_key());
+#endif
             co_return boost::system::error_code {};
         } catch (const boost::system::system_error& error) {
             close();
@@ -161,14 +227,29 @@ public:
     }
 
 
+    net::awaitable<void> async_connect(tcp::socket& socket,
+                                       const tcp::resolver::results_type& endpoints) {
+        auto timeout = timeout_policy_ == timeout_policy::never
+                           ? std::chrono::steady_clock::duration::max()
+                           : timeout_;
+        boost::system::error_code ec;
+        co_await async_connect_staggered(
+            socket, endpoints, connect_attempt_delay_, timeout, ec);
+        if (ec) throw boost::system::system_error(ec);
+    }
+
+    std::string tls_session_key() const { return fmt::format("{}:{}", host_, port_); }
+
     net::any_io_executor executor_;
-    tcp::resolver resolver_;
     timeout_policy timeout_policy_ = timeout_policy::overall;
     std::chrono::steady_clock::duration timeout_ = std::chrono::seconds(30);
+    std::chrono::steady_clock::duration connect_attempt_delay_ =
+        std::chrono::milliseconds(250);
     std::string host_;
     uint16_t port_ = 0;
     std::unique_ptr<http_variant_stream_type> variant_stream_;
     bool use_ssl_ = false;
+    tls_handshake_stats tls_stats_;
 };
 
 client::client(net::io_context& ex, std::string_view host, uint16_t port)
@@ -187,6 +268,11 @@ void client::set_timeout(const std::chrono::steady_clock::duration& duration) {
     impl_->set_timeout(duration);
 }
 
+void client::set_connect_attempt_delay(
+    const std::chrono::steady_clock::duration& duration) {
+    impl_->set_connect_attempt_delay(duration);
+}
+
 void client::set_use_ssl(bool ssl) { impl_->set_use_ssl(ssl); }
 
 net::awaitable<client::response_result>
@@ -243,4 +329,6 @@ void client::close() { impl_->close(); }
 
 bool client::is_connected() { return impl_->is_connected(); }
 
+tls_handshake_stats client::tls_stats() const { return impl_->tls_stats_; }
+
 } // namespace httplib
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "httplib/client_pool.hpp"
+
+#include "httplib/use_awaitable.hpp"
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <deque>
+#include <fmt/format.h>
+#include <mutex>
+#include <unordered_map>
+
+namespace httplib {
+
+class client_pool::impl : public std::enable_shared_from_this<impl> {
+public:
+    impl(const net::any_io_executor& ex, const client_pool::options& opts)
+        : executor_(ex), options_(opts) { }
+
+    net::awaitable<client_pool::lease_result>
+    async_acquire(std::string_view scheme, std::string_view host, uint16_t port) {
+        auto key = fmt::format("{}://{}:{}", scheme, host, port);
+        auto deadline = std::chrono::steady_clock::now() + options_.timeout;
+        auto make_client = [&]() {
+            auto c = std::make_unique<client>(executor_, host, port);
+            c->set_use_ssl(scheme == "https");
+            c->set_timeout(options_.timeout);
+            return c;
+        };
+
+        std::unique_ptr<client> conn;
+        std::vector<std::unique_ptr<client>> dropped;
+        auto w = std::make_shared<waiter>(executor_);
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            auto& entry = hosts_[key];
+            evict_idle(entry, dropped);
+            while (!entry.idle.empty()) {
+                auto c = std::move(entry.idle.back().conn);
+                entry.idle.pop_back();
+                if (c->is_connected()) {
+                    conn = std::move(c);
+                    break;
+                }
+                dropped.push_back(std::move(c));
+            }
+            if (!conn && entry.in_use < options_.max_per_host) conn = make_client();
+            if (conn)
+                entry.in_use++;
+            else
+                entry.waiters.push_back(w);
+        }
+        if (conn) co_return client_pool::lease(shared_from_this(), key, std::move(conn));
+
+        // release() may run on any thread, it grants the slot under the mutex and then
+        // signals the channel, which buffers the wakeup if the wait has not started yet
+        using namespace net::experimental::awaitable_operators;
+        net::steady_timer timer(executor_);
+        timer.expires_at(deadline);
+        boost::system::error_code ec, timer_ec;
+        co_await (w->ready.async_receive(net_awaitable[ec]) ||
+                  timer.async_wait(net_awaitable[timer_ec]));
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            // a grant racing the deadline still wins
+            if (!w->granted) {
+                std::erase(hosts_[key].waiters, w);
+                co_return net::error::timed_out;
+            }
+        }
+
+        // the slot is still counted as in use, now on our behalf
+        conn = std::move(w->conn);
+        if (!conn) conn = make_client();
+        co_return client_pool::lease(shared_from_this(), key, std::move(conn));
+    }
+
+    void release(const std::string& key, std::unique_ptr<client> conn) {
+        std::unique_lock<std::mutex> lck(mtx_);
+        auto& entry = hosts_[key];
+        if (conn && !conn->is_connected()) conn.reset();
+
+        if (!entry.waiters.empty()) {
+            // hand the slot and the connection over to the longest waiting acquirer
+            auto w = std::move(entry.waiters.front());
+            entry.waiters.pop_front();
+            w->granted = true;
+            w->conn = std::move(conn);
+            w->ready.try_send(boost::system::error_code {});
+            return;
+        }
+
+        entry.in_use--;
+        if (conn && entry.idle.size() < options_.max_idle_per_host)
+            entry.idle.push_back({std::move(conn), std::chrono::steady_clock::now()});
+    }
+
+    void evict_idle() {
+        std::vector<std::unique_ptr<client>> dropped;
+        std::unique_lock<std::mutex> lck(mtx_);
+        for (auto& [key, entry] : hosts_)
+            evict_idle(entry, dropped);
+    }
+
+    std::size_t idle_count() const {
+        std::unique_lock<std::mutex> lck(mtx_);
+        std::size_t count = 0;
+        for (const auto& [key, entry] : hosts_)
+            count += entry.idle.size();
+        return count;
+    }
+
+private:
+    struct idle_client {
+        std::unique_ptr<client> conn;
+        std::chrono::steady_clock::time_point since;
+    };
+    struct waiter {
+        explicit waiter(const net::any_io_executor& ex) : ready(ex, 1) { }
+
+        // thread-safe, with room for the single wakeup a waiter ever gets
+        net::experimental::concurrent_channel<void(boost::system::error_code)> ready;
+        // set under the pool mutex together with the handed over connection, which is
+        // null when release() had none worth reusing
+        bool granted = false;
+        std::unique_ptr<client> conn;
+    };
+    struct host_entry {
+        std::deque<idle_client> idle;
+        std::size_t in_use = 0;
+        std::deque<std::shared_ptr<waiter>> waiters;
+    };
+
+    // idle connections are ordered oldest first, the expired ones are at the front
+    void evict_idle(host_entry& entry, std::vector<std::unique_ptr<client>>& dropped) {
+        auto now = std::chrono::steady_clock::now();
+        while (!entry.idle.empty() &&
+               now - entry.idle.front().since >= options_.idle_timeout) {
+            dropped.push_back(std::move(entry.idle.front().conn));
+            entry.idle.pop_front();
+        }
+    }
+
+    net::any_io_executor executor_;
+    client_pool::options options_;
+
+    mutable std::mutex mtx_;
+    std::unordered_map<std::string, host_entry> hosts_;
+};
+
+client_pool::lease::lease(std::shared_ptr<impl> pool,
+                          std::string key,
+                          std::unique_ptr<client> c)
+    : pool_(std::move(pool)), key_(std::move(key)), client_(std::move(c)) { }
+
+client_pool::lease& client_pool::lease::operator=(lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = std::move(other.pool_);
+        key_ = std::move(other.key_);
+        client_ = std::move(other.client_);
+    }
+    return *this;
+}
+
+client_pool::lease::~lease() { release(); }
+
+void client_pool::lease::release() {
+    if (!pool_ || !client_) return;
+    pool_->release(key_, std::move(client_));
+    pool_.reset();
+}
+
+client_pool::client_pool(const net::any_io_executor& ex, const options& opts)
+    : impl_(std::make_shared<impl>(ex, opts)) { }
+
+client_pool::client_pool(const net::any_io_executor& ex) : client_pool(ex, options {}) { }
+
+client_pool::~client_pool() = default;
+
+net::awaitable<client_pool::lease_result>
+client_pool::async_acquire(std::string_view scheme, std::string_view host, uint16_t port) {
+    return impl_->async_acquire(scheme, host, port);
+}
+
+net::awaitable<client::response_result>
+client_pool::async_get(std::string_view scheme,
+                       std::string_view host,
+                       uint16_t port,
+                       std::string_view path,
+                       const html::query_params& params /*= {}*/,
+                       const http::fields& headers /*= http::fields()*/) {
+    auto conn = co_await async_acquire(scheme, host, port);
+    if (!conn) co_return conn.error();
+    co_return co_await (*conn)->async_get(path, params, headers);
+}
+
+net::awaitable<client::response_result>
+client_pool::async_post(std::string_view scheme,
+                        std::string_view host,
+                        uint16_t port,
+                        std::string_view path,
+                        std::string_view body,
+                        const http::fields& headers /*= http::fields()*/) {
+    auto conn = co_await async_acquire(scheme, host, port);
+    if (!conn) co_return conn.error();
+    co_return co_await (*conn)->async_post(path, body, headers);
+}
+
+void client_pool::evict_idle() { impl_->evict_idle(); }
+
+std::size_t client_pool::idle_count() const { return impl_->idle_count(); }
+
+} // namespace httplib
@@ -0,0 +1,94 @@
+#include "compressed_cache.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace httplib {
+
+void compressed_cache::frequency_sketch::increment(std::string_view key) {
+    auto hash = std::hash<std::string_view> {}(key);
+    for (std::size_t row = 0; row < rows_.size(); ++row) {
+        auto& counter = rows_[row][index(hash, row)];
+        if (counter < 15) ++counter;
+    }
+    if (++additions_ < sample_size) return;
+
+    for (auto& row : rows_) {
+        for (auto& counter : row)
+            counter >>= 1;
+    }
+    additions_ /= 2;
+}
+
+std::uint8_t compressed_cache::frequency_sketch::estimate(std::string_view key) const {
+    auto hash = std::hash<std::string_view> {}(key);
+    std::uint8_t result = 15;
+    for (std::size_t row = 0; row < rows_.size(); ++row)
+        result = std::min(result, rows_[row][index(hash, row)]);
+    return result;
+}
+
+std::size_t compressed_cache::frequency_sketch::index(std::size_t hash, std::size_t row) {
+    static constexpr std::uint64_t seeds[] = {0x9e3779b97f4a7c15,
+                                              0xc2b2ae3d27d4eb4f,
+                                              0x165667b19e3779f9,
+                                              0x27d4eb2f165667c5};
+    std::uint64_t h = (std::uint64_t(hash) ^ (std::uint64_t(hash) >> 31)) * seeds[row];
+    return static_cast<std::size_t>(h >> (64 - width_bits));
+}
+
+compressed_cache& compressed_cache::instance() {
+    static compressed_cache cache;
+    return cache;
+}
+
+compressed_cache::buffer compressed_cache::find(std::string_view key) {
+    std::lock_guard<std::mutex> lck(mtx_);
+    sketch_.increment(key);
+
+    auto iter = index_.find(key);
+    if (iter == index_.end()) return nullptr;
+    lru_.splice(lru_.begin(), lru_, iter->second);
+    return iter->second->value;
+}
+
+void compressed_cache::insert(std::string_view key, buffer value, std::size_t budget) {
+    if (!value || value->size() > budget) return;
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto iter = index_.find(key);
+    if (iter != index_.end()) {
+        size_ = size_ - iter->second->value->size() + value->size();
+        iter->second->value = std::move(value);
+        lru_.splice(lru_.begin(), lru_, iter->second);
+    } else {
+        // the victims are only evicted if the newcomer beats every one of them
+        auto frequency = sketch_.estimate(key);
+        std::size_t freed = 0;
+        std::size_t victims = 0;
+        for (auto victim = lru_.rbegin();
+             size_ - freed + value->size() > budget && victim != lru_.rend();
+             ++victim, ++victims) {
+            if (sketch_.estimate(victim->key) >= frequency) return;
+            freed += victim->value->size();
+        }
+        for (; victims != 0; --victims) {
+            size_ -= lru_.back().value->size();
+            index_.erase(lru_.back().key);
+            lru_.pop_back();
+        }
+
+        size_ += value->size();
+        lru_.push_front(node {std::string(key), std::move(value)});
+        index_.emplace(lru_.front().key, lru_.begin());
+    }
+
+    // a smaller budget than before, trim the tail
+    while (size_ > budget && !lru_.empty()) {
+        size_ -= lru_.back().value->size();
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+}
+
+} // namespace httplib
@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace httplib {
+
+// Process wide cache of compressed representations, small static files and directory
+// listings, shared by every response serving them.
+//
+// Keys name the content together with its version and encoding, e.g. path, modification
+// time and "br", so a changed file is never served stale; outdated entries simply age
+// out. The payload is bounded by a byte budget passed in by the caller. Admission
+// follows TinyLFU: a count-min sketch estimates how often each key was asked for
+// recently, and a full cache only takes a new entry when it is wanted more often than
+// the least recently used entries it would evict, so one-off requests cannot flush the
+// hot set.
+class compressed_cache {
+public:
+    using buffer = std::shared_ptr<const std::string>;
+
+    static compressed_cache& instance();
+
+    // counts the access for admission, null on a miss
+    buffer find(std::string_view key);
+    // keeps `value` unless it is larger than `budget` or loses admission
+    void insert(std::string_view key, buffer value, std::size_t budget);
+
+private:
+    // 4 bit saturating counters in 4 rows, halved every `sample_size` increments so
+    // the estimates follow recent traffic
+    class frequency_sketch {
+    public:
+        static constexpr std::size_t width_bits  = 12;
+        static constexpr std::size_t width       = std::size_t(1) << width_bits;
+        static constexpr std::size_t sample_size = 10 * width;
+
+        void increment(std::string_view key);
+        std::uint8_t estimate(std::string_view key) const;
+
+    private:
+        static std::size_t index(std::size_t hash, std::size_t row);
+
+        std::array<std::array<std::uint8_t, width>, 4> rows_ {};
+        std::size_t additions_ = 0;
+    };
+
+    struct node {
+        std::string key;
+        buffer value;
+    };
+
+    std::mutex mtx_;
+    frequency_sketch sketch_;
+    std::size_t size_ = 0;
+    // most recently used first
+    std::list<node> lru_;
+    std::unordered_map<std::string_view, std::list<node>::iterator> index_;
+};
+
+} // namespace httplib
@@ -0,0 +1,301 @@
+#include "httplib/dns_cache.hpp"
+
+#include "httplib/use_awaitable.hpp"
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <charconv>
+#include <fmt/format.h>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace httplib {
+
+namespace {
+net::awaitable<dns_cache::results_type> system_resolve(const std::string& host,
+                                                       const std::string& service,
+                                                       boost::system::error_code& ec) {
+    tcp::resolver resolver(co_await net::this_coro::executor);
+    co_return co_await resolver.async_resolve(host, service, net_awaitable[ec]);
+}
+} // namespace
+
+class dns_cache::impl : public std::enable_shared_from_this<impl> {
+    using clock = std::chrono::steady_clock;
+    // complete() may run on any thread, the channel buffers its single wakeup
+    using signal = net::experimental::concurrent_channel<void(boost::system::error_code)>;
+
+    // a lookup in flight, every caller missing the same name waits for it
+    struct lookup {
+        results_type results;
+        boost::system::error_code error;
+        bool done = false;
+        std::vector<std::shared_ptr<signal>> waiters;
+    };
+
+    // Completes a lookup exactly once. A frame destroyed before its lookup finished,
+    // e.g. on shutdown, completes it with operation_aborted so that the name does not
+    // stay pending.
+    class lookup_guard {
+    public:
+        lookup_guard(std::shared_ptr<impl> self,
+                     std::string key,
+                     std::shared_ptr<lookup> pending)
+            : self_(std::move(self))
+            , key_(std::move(key))
+            , pending_(std::move(pending)) { }
+        lookup_guard(lookup_guard&&) = default;
+        ~lookup_guard() {
+            if (self_) self_->complete(key_, pending_, {}, net::error::operation_aborted);
+        }
+
+        void complete(const results_type& results, const boost::system::error_code& ec) {
+            auto self = std::move(self_);
+            self->complete(key_, pending_, results, ec);
+        }
+
+    private:
+        std::shared_ptr<impl> self_;
+        std::string key_;
+        std::shared_ptr<lookup> pending_;
+    };
+
+    struct entry {
+        results_type results;
+        boost::system::error_code error;
+        bool resolved = false;
+        clock::time_point expires;
+        std::shared_ptr<lookup> pending;
+    };
+
+public:
+    impl(const options& opts, resolve_function resolver)
+        : options_(opts), resolver_(std::move(resolver)) { }
+
+    void set_options(const options& opts) {
+        std::lock_guard<std::mutex> lck(mtx_);
+        options_ = opts;
+    }
+    void set_resolver(resolve_function resolver) {
+        std::lock_guard<std::mutex> lck(mtx_);
+        resolver_ = std::move(resolver);
+    }
+
+    net::awaitable<results_type> async_resolve(std::string_view host,
+                                               std::string_view service,
+                                               boost::system::error_code& ec) {
+        ec = {};
+        if (auto literal = resolve_literal(host, service)) co_return *literal;
+
+        auto ex = co_await net::this_coro::executor;
+        auto key = fmt::format("{}:{}", host, service);
+        std::shared_ptr<lookup> pending;
+        bool leader = false;
+        bool stale = false;
+        results_type stale_results;
+        clock::time_point deadline;
+        {
+            auto now = clock::now();
+            std::lock_guard<std::mutex> lck(mtx_);
+            auto& e = entries_[key];
+            if (e.resolved && now < e.expires) {
+                ec = e.error;
+                co_return e.results;
+            }
+            if (e.resolved && !e.error && now < e.expires + options_.stale_ttl) {
+                // served stale, one caller starts the refresh
+                if (!e.pending) {
+                    e.pending = std::make_shared<lookup>();
+                    pending = e.pending;
+                }
+                stale = true;
+                stale_results = e.results;
+            } else {
+                if (!e.pending) {
+                    e.pending = std::make_shared<lookup>();
+                    leader = true;
+                }
+                pending = e.pending;
+                deadline = now + options_.timeout;
+            }
+        }
+
+        // the guard takes the mutex when it completes, so neither it nor the refresh
+        // are set up while the lock is held
+        if (stale) {
+            if (pending) {
+                lookup_guard guard(shared_from_this(), key, pending);
+                auto task =
+                    refresh(std::move(guard), std::string(host), std::string(service));
+                net::co_spawn(ex, std::move(task), net::detached);
+            }
+            co_return stale_results;
+        }
+
+        if (leader) {
+            lookup_guard guard(shared_from_this(), key, pending);
+            auto results = co_await resolve(std::string(host), std::string(service), ec);
+            guard.complete(results, ec);
+            co_return results;
+        }
+
+        auto waiter = std::make_shared<signal>(ex, 1);
+        bool done = false;
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            done = pending->done;
+            if (!done) pending->waiters.push_back(waiter);
+        }
+        // woken up by complete() signalling the channel, or at the deadline
+        if (!done) {
+            using namespace net::experimental::awaitable_operators;
+            net::steady_timer timer(ex, deadline);
+            boost::system::error_code wait_ec, timer_ec;
+            co_await (waiter->async_receive(net_awaitable[wait_ec]) ||
+                      timer.async_wait(net_awaitable[timer_ec]));
+
+            std::lock_guard<std::mutex> lck(mtx_);
+            if (!pending->done) {
+                std::erase(pending->waiters, waiter);
+                ec = net::error::timed_out;
+                co_return results_type {};
+            }
+        }
+
+        ec = pending->error;
+        co_return pending->results;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lck(mtx_);
+        // lookups in flight still complete their waiters
+        std::erase_if(entries_, [](const auto& item) { return !item.second.pending; });
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lck(mtx_);
+        return entries_.size();
+    }
+
+private:
+    static std::optional<results_type> resolve_literal(std::string_view host,
+                                                       std::string_view service) {
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+            host = host.substr(1, host.size() - 2);
+
+        boost::system::error_code ec;
+        auto address = net::ip::make_address(host, ec);
+        if (ec) return std::nullopt;
+
+        uint16_t port = 0;
+        auto end = service.data() + service.size();
+        auto [ptr, errc] = std::from_chars(service.data(), end, port);
+        if (errc != std::errc() || ptr != end) return std::nullopt;
+
+        return results_type::create(
+            tcp::endpoint(address, port), std::string(host), std::string(service));
+    }
+
+    net::awaitable<results_type> resolve(const std::string& host,
+                                         const std::string& service,
+                                         boost::system::error_code& ec) {
+        resolve_function resolver;
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            resolver = resolver_;
+        }
+        if (!resolver) co_return co_await system_resolve(host, service, ec);
+        co_return co_await resolver(host, service, ec);
+    }
+
+    net::awaitable<void>
+    refresh(lookup_guard guard, std::string host, std::string service) {
+        boost::system::error_code ec;
+        auto results = co_await resolve(host, service, ec);
+        guard.complete(results, ec);
+    }
+
+    void complete(const std::string& key,
+                  const std::shared_ptr<lookup>& pending,
+                  const results_type& results,
+                  const boost::system::error_code& ec) {
+        auto now = clock::now();
+        std::lock_guard<std::mutex> lck(mtx_);
+        pending->results = results;
+        pending->error = ec;
+        pending->done = true;
+        for (auto& waiter : pending->waiters)
+            waiter->try_send(boost::system::error_code {});
+        pending->waiters.clear();
+
+        auto iter = entries_.find(key);
+        if (iter == entries_.end() || iter->second.pending != pending) return;
+        auto& e = iter->second;
+        e.pending.reset();
+
+        // a cancelled lookup says nothing about the name, a failed refresh keeps
+        // serving the old answer until it is too stale
+        if (ec == net::error::operation_aborted) {
+            if (!e.resolved) entries_.erase(iter);
+            return;
+        }
+        if (ec && e.resolved && !e.error) return;
+
+        e.results = results;
+        e.error = ec;
+        e.resolved = true;
+        e.expires = now + (ec ? options_.negative_ttl : options_.ttl);
+        if (entries_.size() > options_.max_entries) evict(now);
+    }
+
+    // drops what can no longer be served, then arbitrary idle entries
+    void evict(clock::time_point now) {
+        std::erase_if(entries_, [&](const auto& item) {
+            const auto& e = item.second;
+            return !e.pending && now >= e.expires + options_.stale_ttl;
+        });
+        for (auto iter = entries_.begin();
+             entries_.size() > options_.max_entries && iter != entries_.end();) {
+            if (iter->second.pending)
+                ++iter;
+            else
+                iter = entries_.erase(iter);
+        }
+    }
+
+    mutable std::mutex mtx_;
+    options options_;
+    resolve_function resolver_;
+    std::unordered_map<std::string, entry> entries_;
+};
+
+dns_cache& dns_cache::instance() {
+    static dns_cache _instance;
+    return _instance;
+}
+
+dns_cache::dns_cache()
+    : dns_cache(options {}) { }
+dns_cache::dns_cache(const options& opts, resolve_function resolver)
+    : impl_(std::make_shared<impl>(opts, std::move(resolver))) { }
+dns_cache::~dns_cache() = default;
+
+void dns_cache::set_options(const options& opts) { impl_->set_options(opts); }
+void dns_cache::set_resolver(resolve_function resolver) {
+    impl_->set_resolver(std::move(resolver));
+}
+
+net::awaitable<dns_cache::results_type> dns_cache::async_resolve(
+    std::string_view host, std::string_view service, boost::system::error_code& ec) {
+    co_return co_await impl_->async_resolve(host, service, ec);
+}
+
+void dns_cache::clear() { impl_->clear(); }
+std::size_t dns_cache::size() const { return impl_->size(); }
+
+} // namespace httplib
@@ -0,0 +1,160 @@
+#include "file_cache.hpp"
+
+#include "httplib/html.hpp"
+#include "mime_types.hpp"
+#include <fmt/format.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace httplib {
+
+namespace {
+#ifndef _WIN32
+fs::file_type file_type(mode_t mode) {
+    if (S_ISREG(mode)) return fs::file_type::regular;
+    if (S_ISDIR(mode)) return fs::file_type::directory;
+    if (S_ISBLK(mode)) return fs::file_type::block;
+    if (S_ISCHR(mode)) return fs::file_type::character;
+    if (S_ISFIFO(mode)) return fs::file_type::fifo;
+    if (S_ISSOCK(mode)) return fs::file_type::socket;
+    return fs::file_type::unknown;
+}
+#endif
+} // namespace
+
+file_cache& file_cache::instance() {
+    static file_cache cache;
+    return cache;
+}
+
+void file_cache::set_options(const options& opts) {
+    std::lock_guard<std::mutex> lck(mtx_);
+    options_ = opts;
+}
+
+std::shared_ptr<const file_cache::entry> file_cache::stat(const fs::path& path) {
+    auto key = path.string();
+    auto now = std::chrono::steady_clock::now();
+
+    std::shared_ptr<const entry> stale;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        auto hit = found_.find(key);
+        if (!hit) hit = missing_.find(key);
+        if (hit) {
+            if (now - hit->checked < options_.ttl) return hit->value;
+            stale = hit->value;
+        }
+    }
+
+    // the filesystem is touched outside the lock, concurrent misses on one path may
+    // both load it and the last one wins
+    auto value = load(path, stale);
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (value->type == fs::file_type::not_found) {
+        found_.erase(key);
+        missing_.put(std::move(key), value, now, max_misses);
+    } else {
+        missing_.erase(key);
+        found_.put(std::move(key), value, now, options_.capacity);
+    }
+    return value;
+}
+
+file_cache::node* file_cache::lru_list::find(const std::string& key) {
+    auto iter = index_.find(key);
+    if (iter == index_.end()) return nullptr;
+    nodes_.splice(nodes_.begin(), nodes_, iter->second);
+    return &*iter->second;
+}
+
+void file_cache::lru_list::put(std::string key,
+                               std::shared_ptr<const entry> value,
+                               std::chrono::steady_clock::time_point checked,
+                               std::size_t capacity) {
+    if (auto hit = find(key)) {
+        hit->value = std::move(value);
+        hit->checked = checked;
+        return;
+    }
+    nodes_.push_front(node {std::move(key), std::move(value), checked});
+    index_.emplace(nodes_.front().key, nodes_.begin());
+    while (nodes_.size() > capacity) {
+        index_.erase(nodes_.back().key);
+        nodes_.pop_back();
+    }
+}
+
+void file_cache::lru_list::erase(const std::string& key) {
+    auto iter = index_.find(key);
+    if (iter == index_.end()) return;
+    auto pos = iter->second;
+    index_.erase(iter);
+    nodes_.erase(pos);
+}
+
+std::shared_ptr<const file_cache::entry>
+file_cache::load(const fs::path& path, const std::shared_ptr<const entry>& old) {
+    auto value = std::make_shared<entry>();
+
+#ifdef _WIN32
+    std::error_code ec;
+    value->type = fs::status(path, ec).type();
+    if (ec || value->type != fs::file_type::regular) {
+        if (ec) value->type = fs::file_type::not_found;
+        return value;
+    }
+
+    fs::file_time_type write_time;
+    value->size = fs::file_size(path, ec);
+    if (!ec) write_time = fs::last_write_time(path, ec);
+    if (!ec) value->last_write_time = html::file_last_write_time(path, ec);
+    if (ec) {
+        value->type = fs::file_type::not_found;
+        return value;
+    }
+    auto since_epoch = write_time.time_since_epoch();
+    value->write_time_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count();
+#else
+    // one stat gives everything, the std::filesystem calls would each make their own
+    struct ::stat st;
+    if (::stat(path.c_str(), &st) != 0) return value;
+    value->type = file_type(st.st_mode);
+    if (value->type != fs::file_type::regular) return value;
+
+#ifdef __APPLE__
+    const auto& mtime = st.st_mtimespec;
+#else
+    const auto& mtime = st.st_mtim;
+#endif
+    value->size = st.st_size;
+    value->last_write_time = st.st_mtime;
+    value->write_time_ns = std::int64_t(mtime.tv_sec) * 1'000'000'000 + mtime.tv_nsec;
+    value->device = st.st_dev;
+    value->inode = st.st_ino;
+#endif
+
+    // the same file, unchanged since the last check: keep serving from its descriptor
+    if (old && old->type == fs::file_type::regular && old->size == value->size &&
+        old->write_time_ns == value->write_time_ns && old->device == value->device &&
+        old->inode == value->inode)
+        return old;
+
+    boost::system::error_code open_ec;
+    value->file = body::shared_file::open(path, open_ec);
+    if (open_ec) {
+        value->type = fs::file_type::not_found;
+        return value;
+    }
+    // the descriptor may see a newer file than the stat did
+    value->size = value->file->size();
+    value->etag = fmt::format("W/{}-{}", value->size, value->last_write_time);
+    value->last_modified = html::format_http_gmt_date(value->last_write_time);
+    value->content_type = mime::get_mime_type(path.extension().string());
+    return value;
+}
+
+} // namespace httplib
@@ -0,0 +1,91 @@
+#pragma once
+#include "httplib/body/file_body.hpp"
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace httplib {
+
+// Process wide cache of what static file responses need to know about a path: its
+// type, size, modification time, the validators derived from them and, for regular
+// files, an open descriptor shared by every response serving the file.
+//
+// Entries are trusted for `ttl` and then revalidated with a stat; the descriptor is
+// kept while device, inode, size and the full resolution modification time are the
+// same, so neither a rename() over the file nor a rewrite in place is missed. The
+// least recently used entry is dropped once `capacity` paths are cached, responses
+// still holding its descriptor keep it open until they are done. Paths that do not
+// exist are remembered apart, in at most `max_misses` entries, so probing for missing
+// files cannot push out the open ones.
+class file_cache {
+public:
+    static constexpr std::size_t max_misses = 1024;
+
+    struct options {
+        // each cached regular file holds a descriptor
+        std::size_t capacity = 256;
+        std::chrono::steady_clock::duration ttl = std::chrono::seconds(2);
+    };
+
+    struct entry {
+        fs::file_type type = fs::file_type::not_found;
+        std::uint64_t size = 0;
+        std::time_t last_write_time = 0;
+        // what tells a reopened or rewritten file apart, device and inode are 0 where
+        // the platform has none
+        std::int64_t write_time_ns = 0;
+        std::uint64_t device = 0;
+        std::uint64_t inode = 0;
+        std::string etag;
+        std::string last_modified;
+        std::string content_type;
+        // open for regular files only
+        std::shared_ptr<const body::shared_file> file;
+    };
+
+    static file_cache& instance();
+
+    // a smaller capacity takes effect as entries are added
+    void set_options(const options& opts);
+
+    // never null, a path that does not exist yields an entry of type not_found
+    std::shared_ptr<const entry> stat(const fs::path& path);
+
+private:
+    struct node {
+        std::string key;
+        std::shared_ptr<const entry> value;
+        std::chrono::steady_clock::time_point checked;
+    };
+
+    class lru_list {
+    public:
+        // moves a hit to the front
+        node* find(const std::string& key);
+        void put(std::string key,
+                 std::shared_ptr<const entry> value,
+                 std::chrono::steady_clock::time_point checked,
+                 std::size_t capacity);
+        void erase(const std::string& key);
+
+    private:
+        // most recently used first
+        std::list<node> nodes_;
+        std::unordered_map<std::string_view, std::list<node>::iterator> index_;
+    };
+
+    static std::shared_ptr<const entry> load(const fs::path& path,
+                                             const std::shared_ptr<const entry>& old);
+
+    std::mutex mtx_;
+    options options_;
+    lru_list found_;
+    lru_list missing_;
+};
+
+} // namespace httplib
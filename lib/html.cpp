@@ -361,6 +361,30 @@ generate_boundary()
     return "----------------" + std::to_string(millis) + std::to_string(dist(gen));
 }
 
+namespace detail {
+// visits the parts util::split(str, delimiter) returns, without collecting them
+template<typename F>
+static void
+for_each_split(std::string_view str, std::string_view delimiter, F&& f)
+{
+    if (str.empty()) return;
+
+    std::string_view::size_type pos = 0;
+    while (pos != std::string_view::npos) {
+        const auto pos_found = str.find(delimiter, pos);
+        if (pos_found == 0) {
+            pos += delimiter.size();
+            continue;
+        }
+        f(boost::trim_copy(str.substr(pos, pos_found - pos)));
+
+        if (pos_found + delimiter.size() >= str.size()) break;
+        if (pos_found == std::string_view::npos) break;
+        pos = pos_found + delimiter.size();
+    }
+}
+} // namespace detail
+
 query_params
 parse_http_query_params(std::string_view content, bool& is_valid)
 {
@@ -383,6 +407,29 @@ parse_http_query_params(std::string_view content, bool& is_valid)
     return result;
 }
 
+bool
+is_valid_http_query_params(std::string_view content)
+{
+    // every "&" separated item splits into exactly a key and a value
+    bool is_valid = true;
+    detail::for_each_split(content, "&", [&](std::string_view item) {
+        std::size_t parts = 0;
+        detail::for_each_split(item, "=", [&](std::string_view) { ++parts; });
+        if (parts != 2) is_valid = false;
+    });
+    return is_valid;
+}
+
+bool
+is_not_modified(std::string_view if_none_match,
+                std::string_view if_modified_since,
+                std::string_view etag,
+                std::string_view last_modified)
+{
+    if (!if_none_match.empty()) return if_none_match == etag;
+    return !if_modified_since.empty() && if_modified_since == last_modified;
+}
+
 std::string
 make_http_query_params(const query_params& params)
 {
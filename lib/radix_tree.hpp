@@ -2,11 +2,15 @@
 
 #include "httplib/http_handler.hpp"
 #include "httplib/util/type_traits.h"
+#include <algorithm>
+#include <array>
 #include <boost/beast/http/verb.hpp>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <string>
 #include <string_view>
-#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace httplib {
@@ -14,216 +18,237 @@ constexpr char type_asterisk = '*';
 constexpr char type_colon    = ':';
 constexpr char type_slash    = '/';
 
-typedef std::
-    tuple<bool, coro_http_handler_type, std::unordered_map<std::string, std::string>>
-        coro_result;
-
 struct coro_handler_t {
     http::verb method = http::verb::unknown;
     coro_http_handler_type coro_handler;
+    route_info info;
 };
 
-struct radix_tree_node {
-    std::string path;
-    coro_handler_t coro_handler;
-    std::string indices;
-    std::vector<std::shared_ptr<radix_tree_node>> children;
-    int max_params = 0;
+// Radix tree over route paths such as "/users/:id" or "/static/*filepath".
+//
+// Nodes live in one contiguous vector and refer to each other by index, handlers in a
+// second one. Lookups compare string_views against the node text and record parameters
+// as views into the looked up path, so matching a route allocates nothing. The tree is
+// keyed by path alone; a node ending a route owns a dense table mapping every verb to
+// its handler.
+class radix_tree {
+public:
+    static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::size_t verb_count =
+        static_cast<std::size_t>(http::verb::unlink) + 1;
+    static_assert(verb_count <= 64, "allowed verbs are kept in a 64 bit mask");
+
+    struct lookup_result {
+        // some route matches the path, possibly for other verbs only
+        bool path_matched = false;
+        const coro_handler_t* route = nullptr;
+        // bit n set when the matched path has a route for verb n, answers 405s
+        std::uint64_t allowed = 0;
+    };
+
+    radix_tree() { nodes_.emplace_back(); }
+
+    // false if the route conflicts with one already registered
+    bool
+    insert(std::string_view path,
+           coro_http_handler_type handler,
+           http::verb method,
+           const route_info& info = {})
+    {
+        std::uint32_t n = 0;
+        std::size_t i   = 0;
+        while (i < path.size()) {
+            if (path[i] == type_colon) {
+                auto end  = std::min(path.find(type_slash, i), path.size());
+                auto name = path.substr(i + 1, end - i - 1);
+                n         = add_wildcard(n, node_kind::param, name);
+                i         = end;
+            } else if (path[i] == type_asterisk) {
+                n = add_wildcard(n, node_kind::catch_all, path.substr(i + 1));
+                i = path.size();
+            } else {
+                auto end = std::min(path.find_first_of("*:", i), path.size());
+                n        = add_static(n, path.substr(i, end - i));
+                i        = end;
+            }
+            if (n == npos) return false;
+        }
 
-    radix_tree_node() = default;
-    radix_tree_node(const std::string& path) { this->path = path; }
-    ~radix_tree_node() { }
+        if (nodes_[n].verbs == npos) {
+            nodes_[n].verbs = static_cast<std::uint32_t>(verb_tables_.size());
+            verb_tables_.emplace_back().fill(npos);
+        }
+        auto& slot = verb_tables_[nodes_[n].verbs][static_cast<std::size_t>(method)];
+        if (slot != npos) return false;
 
-    coro_http_handler_type
-    get_coro_handler(const http::verb& method)
-    {
-        if (coro_handler.method == method) { return coro_handler.coro_handler; }
-        return nullptr;
+        slot = static_cast<std::uint32_t>(routes_.size());
+        routes_.push_back(coro_handler_t {method, std::move(handler), info});
+        nodes_[n].allowed |= std::uint64_t(1) << static_cast<std::size_t>(method);
+        return true;
     }
 
-    int
-    add_coro_handler(coro_http_handler_type coro_handler, const http::verb& method)
+    lookup_result
+    find(std::string_view path, http::verb method, route_params& params) const
     {
-        this->coro_handler = coro_handler_t {method, coro_handler};
-        return 0;
+        params.clear();
+        auto n = match(0, path, method, params);
+        if (n != npos) return {true, &routes_[handler_index(nodes_[n], method)]};
+
+        // no route for this verb, tell a path known for other verbs from an unknown one
+        params.clear();
+        n = match(0, path, http::verb::unknown, params);
+        params.clear();
+        if (n == npos) return {};
+        return {true, nullptr, nodes_[n].allowed};
     }
 
-    std::shared_ptr<radix_tree_node>
-    insert_child(char index, std::shared_ptr<radix_tree_node> child)
+private:
+    enum class node_kind : std::uint8_t { static_text, param, catch_all };
+
+    struct node {
+        node_kind kind = node_kind::static_text;
+        // literal text of static nodes, parameter name of the others
+        std::string text;
+        // first character of every static child, sorted, parallel to `children`
+        std::string indices;
+        std::vector<std::uint32_t> children;
+        std::uint32_t param_child     = npos;
+        std::uint32_t catch_all_child = npos;
+        // index into verb_tables_, npos unless a route ends here
+        std::uint32_t verbs = npos;
+        // bit n set when verb n has a route here
+        std::uint64_t allowed = 0;
+    };
+    // index into routes_ per http::verb
+    using verb_table = std::array<std::uint32_t, verb_count>;
+
+    std::uint32_t
+    handler_index(const node& n, http::verb method) const
     {
-        auto i = this->get_index_position(index);
-        this->indices.insert(this->indices.begin() + i, index);
-        this->children.insert(this->children.begin() + i, child);
-        return child;
+        if (n.verbs == npos) return npos;
+        return verb_tables_[n.verbs][static_cast<std::size_t>(method)];
     }
 
-    std::shared_ptr<radix_tree_node>
-    get_child(char index)
+    // a node ends a match when it has a handler for `method`, or any handler at all for
+    // http::verb::unknown
+    bool
+    accepts(const node& n, http::verb method) const
     {
-        auto i = this->get_index_position(index);
-        return this->indices[i] != index ? nullptr : this->children[i];
+        if (method == http::verb::unknown) return n.allowed != 0;
+        return handler_index(n, method) != npos;
     }
 
-    int
-    get_index_position(char target)
+    std::uint32_t
+    new_node(node_kind kind, std::string_view text)
     {
-        int low = 0, high = this->indices.size(), mid;
-
-        while (low < high) {
-            mid = low + ((high - low) >> 1);
-            if (this->indices[mid] < target)
-                low = mid + 1;
-            else
-                high = mid;
-        }
-        return low;
+        node n;
+        n.kind = kind;
+        n.text = std::string(text);
+        nodes_.push_back(std::move(n));
+        return static_cast<std::uint32_t>(nodes_.size() - 1);
     }
-};
-
-class radix_tree {
-public:
-    radix_tree() { this->root = std::make_shared<radix_tree_node>(radix_tree_node()); }
 
-    ~radix_tree() { }
+    std::uint32_t
+    add_wildcard(std::uint32_t parent, node_kind kind, std::string_view name)
+    {
+        if (name.empty()) return npos;
+        auto& slot = kind == node_kind::param ? nodes_[parent].param_child
+                                              : nodes_[parent].catch_all_child;
+        if (slot != npos) return nodes_[slot].text == name ? slot : npos;
+
+        auto child = new_node(kind, name);
+        // new_node may have moved the nodes, look the slot up again
+        (kind == node_kind::param ? nodes_[parent].param_child
+                                  : nodes_[parent].catch_all_child) = child;
+        return child;
+    }
 
-    int
-    coro_insert(const std::string& path,
-                coro_http_handler_type coro_handler,
-                const http::verb& method)
+    std::uint32_t
+    add_static(std::uint32_t n, std::string_view text)
     {
-        auto root = this->root;
-        int i = 0, n = path.size(), param_count = 0, code = 0;
-        while (i < n) {
-            if (!root->indices.empty() &&
-                (root->indices[0] == type_asterisk || path[i] == type_asterisk ||
-                 (path[i] != type_colon && root->indices[0] == type_colon) ||
-                 (path[i] == type_colon && root->indices[0] != type_colon) ||
-                 (path[i] == type_colon && root->indices[0] == type_colon &&
-                  path.substr(i + 1, find_pos(path, type_slash, i) - i - 1) !=
-                      root->children[0]->path))) {
-                code = -1;
-                break;
+        while (!text.empty()) {
+            auto pos = nodes_[n].indices.find(text[0]);
+            if (pos == std::string::npos) {
+                auto child = new_node(node_kind::static_text, text);
+                auto& indices = nodes_[n].indices;
+                auto at = std::lower_bound(indices.begin(), indices.end(), text[0]) -
+                          indices.begin();
+                indices.insert(indices.begin() + at, text[0]);
+                nodes_[n].children.insert(nodes_[n].children.begin() + at, child);
+                return child;
             }
 
-            auto child = root->get_child(path[i]);
-            if (!child) {
-                auto p = find_pos(path, type_colon, i);
-
-                if (p == n) {
-                    p = find_pos(path, type_asterisk, i);
-
-                    root = root->insert_child(
-                        path[i],
-                        std::make_shared<radix_tree_node>(path.substr(i, p - i)));
-
-                    if (p < n) {
-                        root = root->insert_child(
-                            type_asterisk,
-                            std::make_shared<radix_tree_node>(path.substr(p + 1)));
-                        ++param_count;
-                    }
-
-                    code = root->add_coro_handler(coro_handler, method);
-                    break;
-                }
-
-                root = root->insert_child(
-                    path[i], std::make_shared<radix_tree_node>(path.substr(i, p - i)));
-
-                i = find_pos(path, type_slash, p);
-
-                root = root->insert_child(
-                    type_colon,
-                    std::make_shared<radix_tree_node>(path.substr(p + 1, i - p - 1)));
-                ++param_count;
-
-                if (i == n) {
-                    code = root->add_coro_handler(coro_handler, method);
-                    break;
-                }
-            } else {
-                root = child;
-
-                if (path[i] == type_colon) {
-                    ++param_count;
-                    i += root->path.size() + 1;
-
-                    if (i == n) {
-                        code = root->add_coro_handler(coro_handler, method);
-                        break;
-                    }
-                } else {
-                    auto j = 0UL;
-                    auto m = root->path.size();
-
-                    for (; i < n && j < m && path[i] == root->path[j]; ++i, ++j) { }
-
-                    if (j < m) {
-                        std::shared_ptr<radix_tree_node> child(
-                            std::make_shared<radix_tree_node>(root->path.substr(j)));
-                        child->coro_handler = root->coro_handler;
-                        child->indices      = root->indices;
-                        child->children     = root->children;
-
-                        root->path         = root->path.substr(0, j);
-                        root->coro_handler = {};
-                        root->indices      = child->path[0];
-                        root->children     = {child};
-                    }
-
-                    if (i == n) {
-                        code = root->add_coro_handler(coro_handler, method);
-                        break;
-                    }
-                }
+            auto child = nodes_[n].children[pos];
+            std::string_view child_text(nodes_[child].text);
+            std::size_t common = 0;
+            while (common < child_text.size() && common < text.size() &&
+                   child_text[common] == text[common])
+                ++common;
+
+            if (common < child_text.size()) {
+                // split the child, its first `common` chars become a node of their own
+                auto head = new_node(node_kind::static_text, text.substr(0, common));
+                nodes_[child].text.erase(0, common);
+                nodes_[head].indices.push_back(nodes_[child].text[0]);
+                nodes_[head].children.push_back(child);
+                nodes_[n].children[pos] = head;
+                child = head;
             }
+            n    = child;
+            text = text.substr(common);
         }
-
-        if (param_count > this->root->max_params) this->root->max_params = param_count;
-
-        return code;
+        return n;
     }
 
-    coro_result
-    get_coro(const std::string& path, const http::verb& method)
+    // Static children are preferred over a parameter, which is preferred over a
+    // catch-all. Returns the node the whole path ends on, npos if none accepts `method`.
+    std::uint32_t
+    match(std::uint32_t n,
+          std::string_view path,
+          http::verb method,
+          route_params& params) const
     {
-        std::unordered_map<std::string, std::string> params;
-        auto root = this->root;
-
-        int i = 0, n = path.size(), p;
-
-        while (i < n) {
-            if (root->indices.empty()) return coro_result();
-
-            if (root->indices[0] == type_colon) {
-                root = root->children[0];
+        const auto& current = nodes_[n];
+        if (path.empty()) {
+            if (accepts(current, method)) return n;
+            auto catch_all = current.catch_all_child;
+            if (catch_all != npos && accepts(nodes_[catch_all], method)) {
+                params.push_back(nodes_[catch_all].text, path);
+                return catch_all;
+            }
+            return npos;
+        }
 
-                p                  = find_pos(path, type_slash, i);
-                params[root->path] = path.substr(i, p - i);
-                i                  = p;
-            } else if (root->indices[0] == type_asterisk) {
-                root               = root->children[0];
-                params[root->path] = path.substr(i);
-                break;
-            } else {
-                root = root->get_child(path[i]);
-                if (!root || path.substr(i, root->path.size()) != root->path)
-                    return coro_result();
-                i += root->path.size();
+        auto pos = current.indices.find(path[0]);
+        if (pos != std::string::npos) {
+            auto child = current.children[pos];
+            const auto& text = nodes_[child].text;
+            if (path.starts_with(text)) {
+                auto found = match(child, path.substr(text.size()), method, params);
+                if (found != npos) return found;
             }
         }
 
-        return coro_result {true, root->get_coro_handler(method), params};
-    }
+        if (current.param_child != npos) {
+            auto end = std::min(path.find(type_slash), path.size());
+            if (end != 0) {
+                params.push_back(nodes_[current.param_child].text, path.substr(0, end));
+                auto found = match(current.param_child, path.substr(end), method, params);
+                if (found != npos) return found;
+                params.pop_back();
+            }
+        }
 
-private:
-    int
-    find_pos(const std::string& str, char target, int start)
-    {
-        auto i = str.find(target, start);
-        return i == -1 ? str.size() : i;
+        auto catch_all = current.catch_all_child;
+        if (catch_all != npos && accepts(nodes_[catch_all], method)) {
+            params.push_back(nodes_[catch_all].text, path);
+            return catch_all;
+        }
+        return npos;
     }
 
-    std::shared_ptr<radix_tree_node> root;
+    std::vector<node> nodes_;
+    std::vector<verb_table> verb_tables_;
+    std::vector<coro_handler_t> routes_;
 };
-} // namespace httplib
\ No newline at end of file
+} // namespace httplib
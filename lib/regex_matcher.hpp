@@ -0,0 +1,193 @@
+#pragma once
+#include "httplib/http_handler.hpp"
+#include <boost/beast/http/verb.hpp>
+#include <boost/container/small_vector.hpp>
+#include <cctype>
+#include <charconv>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace httplib {
+
+// Regex routes of one verb compiled into a single anchored alternation
+//
+//     (?:(p0)|(p1)|...)
+//
+// so routing runs one regex_match per request instead of one per route. Every route is
+// wrapped in a group of its own: the first wrapper group that participated names the
+// route, the groups right after it are the route's captures. Backreferences are
+// renumbered to match. ECMAScript alternation is ordered, the route registered first
+// wins.
+class regex_matcher {
+public:
+    using matches_type = boost::container::small_vector<std::string_view, 8>;
+
+    struct route {
+        std::string pattern;
+        coro_http_handler_type handler;
+        route_info info;
+    };
+
+    // throws std::regex_error for an invalid pattern, like std::regex does
+    void add(http::verb method,
+             const std::string& pattern,
+             coro_http_handler_type&& handler,
+             const route_info& info) {
+        std::regex validate(pattern);
+
+        auto& table = tables_[method];
+        entry e;
+        e.group = table.groups + 1;
+        e.captures = validate.mark_count();
+        e.prefix = literal_prefix(pattern);
+        e.wrapped = shift_backreferences(pattern, e.group, e.captures);
+        e.value = route {pattern, std::move(handler), info};
+        table.groups += e.captures + 1;
+        table.entries.push_back(std::move(e));
+
+        std::string combined = "(?:";
+        for (std::size_t i = 0; i < table.entries.size(); ++i) {
+            if (i != 0) combined += '|';
+            combined += '(';
+            combined += table.entries[i].wrapped;
+            combined += ')';
+        }
+        combined += ')';
+        table.combined =
+            std::regex(combined, std::regex::ECMAScript | std::regex::optimize);
+    }
+
+    // The first route of `method` matching the whole of `path`. Captures are views into
+    // `path`, matches[0] being the path itself.
+    const route*
+    match(http::verb method, std::string_view path, matches_type* matches) const {
+        auto iter = tables_.find(method);
+        if (iter == tables_.end()) return nullptr;
+        const auto& table = iter->second;
+
+        // most lookups miss on the literal part of every pattern, no regex needed then
+        bool candidate = false;
+        for (const auto& e : table.entries) {
+            if (path.starts_with(e.prefix)) {
+                candidate = true;
+                break;
+            }
+        }
+        if (!candidate) return nullptr;
+
+        // reused per thread, match_results keeps its storage between lookups
+        thread_local std::cmatch results;
+        if (!std::regex_match(
+                path.data(), path.data() + path.size(), results, table.combined))
+            return nullptr;
+
+        for (const auto& e : table.entries) {
+            if (!results[e.group].matched) continue;
+            if (matches) {
+                matches->clear();
+                matches->emplace_back(path);
+                for (std::size_t i = 1; i <= e.captures; ++i) {
+                    const auto& sub = results[e.group + i];
+                    matches->emplace_back(
+                        sub.matched ? std::string_view(sub.first, sub.length())
+                                    : std::string_view());
+                }
+            }
+            return &e.value;
+        }
+        return nullptr;
+    }
+
+private:
+    // literal text before the first regex metacharacter, empty when the pattern starts
+    // with one
+    static std::string literal_prefix(std::string_view pattern) {
+        if (has_top_level_alternation(pattern)) return {};
+
+        constexpr std::string_view meta = "\\^$.|?*+()[]{}";
+        auto n = pattern.find_first_of(meta);
+        if (n == std::string_view::npos) return std::string(pattern);
+        // a quantifier applies to the char before it, which is then not literal either
+        if (n > 0 && std::string_view("?*{").find(pattern[n]) != std::string_view::npos)
+            --n;
+        return std::string(pattern.substr(0, n));
+    }
+
+    // `\n` refers to group n of the route alone, in the alternation that group comes
+    // `offset` groups later
+    static std::string shift_backreferences(std::string_view pattern,
+                                            std::size_t offset,
+                                            std::size_t groups) {
+        std::string out;
+        out.reserve(pattern.size());
+        bool in_class = false;
+        for (std::size_t i = 0; i < pattern.size(); ++i) {
+            char c = pattern[i];
+            if (c == '\\' && i + 1 < pattern.size()) {
+                auto end = i + 1;
+                while (end < pattern.size() && std::isdigit((unsigned char)pattern[end]))
+                    ++end;
+                std::size_t n = 0;
+                auto digits = pattern.substr(i + 1, end - i - 1);
+                std::from_chars(digits.data(), digits.data() + digits.size(), n);
+                if (!in_class && n >= 1 && n <= groups) {
+                    out += '\\';
+                    out += std::to_string(n + offset);
+                    i = end - 1;
+                    continue;
+                }
+                out += c;
+                out += pattern[++i];
+                continue;
+            }
+            if (in_class && c == ']')
+                in_class = false;
+            else if (!in_class && c == '[')
+                in_class = true;
+            out += c;
+        }
+        return out;
+    }
+
+    static bool has_top_level_alternation(std::string_view pattern) {
+        int depth = 0;
+        bool in_class = false;
+        for (std::size_t i = 0; i < pattern.size(); ++i) {
+            char c = pattern[i];
+            if (c == '\\') {
+                ++i;
+            } else if (in_class) {
+                if (c == ']') in_class = false;
+            } else if (c == '[') {
+                in_class = true;
+            } else if (c == '(') {
+                ++depth;
+            } else if (c == ')') {
+                --depth;
+            } else if (c == '|' && depth == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct entry {
+        std::size_t group = 0;
+        std::size_t captures = 0;
+        std::string prefix;
+        // the pattern as it goes into the alternation
+        std::string wrapped;
+        route value;
+    };
+    struct table {
+        std::vector<entry> entries;
+        std::size_t groups = 0;
+        std::regex combined;
+    };
+    std::unordered_map<http::verb, table> tables_;
+};
+
+} // namespace httplib
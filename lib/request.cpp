@@ -22,4 +22,19 @@ request::get_client_ip() const
     return address;
 }
 
+const html::query_params&
+request::query_params() const
+{
+    if (!query_params_) {
+        std::string_view target = this->target();
+        auto pos = target.find('?');
+        std::string_view query;
+        if (pos != std::string_view::npos) query = target.substr(pos + 1);
+
+        bool is_valid = true;
+        query_params_ = html::parse_http_query_params(query, is_valid);
+    }
+    return *query_params_;
+}
+
 } // namespace httplib
\ No newline at end of file
@@ -1,6 +1,6 @@
 #include "httplib/response.hpp"
 
-#include "mime_types.hpp"
+#include "file_cache.hpp"
 #include <fmt/format.h>
 
 namespace httplib {
@@ -70,11 +70,20 @@ response::set_json_content(const body::json_body::value_type& data,
 void
 response::set_file_content(const fs::path& path, const http::fields& req_header)
 {
-    std::error_code ec;
-    auto file_size = fs::file_size(path, ec);
-    if (ec) return;
-    auto file_write_time = html::file_last_write_time(path, ec);
-    if (ec) return;
+    set_file_content(path, req_header, {}, {});
+}
+
+void
+response::set_file_content(const fs::path& path,
+                           const http::fields& req_header,
+                           std::string_view content_encoding,
+                           std::string_view content_type)
+{
+    // size, validators and the open descriptor come from the shared cache, a hit costs
+    // no syscalls at all
+    auto info = file_cache::instance().stat(path);
+    if (info->type != fs::file_type::regular || !info->file) return;
+    auto file_size = info->size;
 
     bool is_valid = true;
     auto ranges =
@@ -84,28 +93,28 @@ response::set_file_content(const fs::path& path, const http::fields& req_header)
         set_empty_content(http::status::range_not_satisfiable);
         return;
     }
-    // etag
-    auto file_etag_str = fmt::format("W/{}-{}", file_size, file_write_time);
-    if (req_header[http::field::if_none_match] == file_etag_str) {
-        set_empty_content(http::status::not_modified);
-        return;
-    }
-    // last modified
-    auto file_gmt_date_str = html::format_http_gmt_date(file_write_time);
-    if (req_header[http::field::if_modified_since] == file_gmt_date_str) {
+    if (html::is_not_modified(req_header[http::field::if_none_match],
+                              req_header[http::field::if_modified_since],
+                              info->etag,
+                              info->last_modified)) {
         set_empty_content(http::status::not_modified);
         return;
     }
 
     body::file_body::value_type file;
-    file.open(path.string().c_str(), std::ios::in | std::ios::binary);
-    if (!file.is_open()) return;
-
-    file.content_type = mime::get_mime_type(path.extension().string());
+    file.assign(info->file);
+    file.content_type = content_type.empty() ? info->content_type
+                                             : std::string(content_type);
     file.ranges       = ranges;
 
-    set(http::field::etag, file_etag_str);
-    set(http::field::last_modified, file_gmt_date_str);
+    set(http::field::etag, info->etag);
+    set(http::field::last_modified, info->last_modified);
+    if (!content_encoding.empty()) {
+        // ranges and the length refer to the encoded bytes, which is what a cache
+        // keyed on Accept-Encoding expects
+        set(http::field::content_encoding, content_encoding);
+        set(http::field::vary, "Accept-Encoding");
+    }
 
     if (file.ranges.empty()) {
         set(http::field::accept_ranges, "bytes");
@@ -130,6 +139,7 @@ response::set_file_content(const fs::path& path, const http::fields& req_header)
         result(http::status::partial_content);
     }
     body() = std::move(file);
+    body().set_encoded(!content_encoding.empty());
 }
 
 void
@@ -145,6 +155,29 @@ response::set_form_data_content(const std::vector<form_data::field>& data)
     body() = std::move(value);
 }
 
+void
+response::set_shared_content(std::shared_ptr<const std::string> data,
+                             std::string_view content_type,
+                             http::status status /*= http::status::ok*/)
+{
+    content_length(data ? data->size() : 0);
+    set(http::field::content_type, content_type);
+    result(status);
+    body() = body::shared_buffer_body::value_type {std::move(data)};
+}
+
+void
+response::set_stream_content(std::function<net::awaitable<std::string>()> producer,
+                             std::string_view content_type,
+                             http::status status /*= http::status::ok*/)
+{
+    result(status);
+    set(http::field::content_type, content_type);
+    // a Content-Length set afterwards switches the body to raw framing
+    chunked(true);
+    body() = body::stream_body::value_type {std::move(producer)};
+}
+
 void
 response::set_redirect(std::string_view url,
                        http::status status /*= http::status::moved_permanently*/)
@@ -0,0 +1,453 @@
+#include "httplib/reverse_proxy.hpp"
+
+#include "httplib/dns_cache.hpp"
+#include "httplib/use_awaitable.hpp"
+#include "stream/happy_eyeballs.hpp"
+#include "stream/socket_alive.hpp"
+#include "httplib/util/misc.hpp"
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/beast/core/basic_stream.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/buffer_body.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/serializer.hpp>
+#include <boost/beast/http/write.hpp>
+#include <algorithm>
+#include <fmt/format.h>
+#include <mutex>
+#include <optional>
+
+namespace httplib {
+
+namespace {
+// bytes moved per read, in both directions
+constexpr std::size_t chunk_size = 16 * 1024;
+// points every upstream gets on the consistent hash ring
+constexpr std::size_t virtual_nodes = 64;
+
+using upstream_stream = beast::basic_stream<net::ip::tcp, net::any_io_executor>;
+
+struct connection {
+    explicit connection(const net::any_io_executor& ex) : stream(ex) { }
+
+    upstream_stream stream;
+    beast::flat_buffer buffer;
+    std::chrono::steady_clock::time_point idle_since;
+};
+
+// fields describing a single connection, they are not forwarded (RFC 9110, 7.6.1)
+bool is_hop_by_hop(const http::fields::value_type& field, std::string_view connection) {
+    switch (field.name()) {
+        case http::field::connection:
+        case http::field::keep_alive:
+        case http::field::proxy_connection:
+        case http::field::proxy_authenticate:
+        case http::field::proxy_authorization:
+        case http::field::te:
+        case http::field::trailer:
+        case http::field::transfer_encoding:
+        case http::field::upgrade: return true;
+        default: break;
+    }
+    for (auto token : util::split(connection, ",")) {
+        auto first = token.find_first_not_of(" \t");
+        if (first == std::string_view::npos) continue;
+        token = token.substr(first, token.find_last_not_of(" \t") - first + 1);
+        if (boost::iequals(token, field.name_string())) return true;
+    }
+    return false;
+}
+
+// replaces the fields of `to` that `from` carries with the end-to-end ones of `from`
+void copy_end_to_end(const http::fields& from, http::fields& to) {
+    std::string_view connection = from[http::field::connection];
+    for (const auto& field : from)
+        to.erase(field.name_string());
+    for (const auto& field : from) {
+        if (!is_hop_by_hop(field, connection))
+            to.insert(field.name_string(), field.value());
+    }
+}
+} // namespace
+
+class reverse_proxy::impl : public std::enable_shared_from_this<impl> {
+    struct node {
+        reverse_proxy::upstream target;
+        // requests in flight
+        std::size_t active = 0;
+        // consecutive failures
+        std::uint32_t failures = 0;
+        std::uint32_t ejections = 0;
+        std::chrono::steady_clock::time_point ejected_until;
+        std::vector<std::unique_ptr<connection>> idle;
+    };
+
+    // One forwarded request. Owned by the response body while it streams, gives the
+    // connection back and records the outcome when it goes away.
+    struct exchange {
+        exchange(std::shared_ptr<impl> proxy, std::size_t index)
+            : proxy(std::move(proxy)), index(index) { }
+        ~exchange() {
+            proxy->release(index, reusable ? std::move(conn) : nullptr, outcome);
+        }
+
+        net::awaitable<std::string> read_some() {
+            if (!conn || parser->is_done()) co_return std::string();
+
+            std::string chunk(chunk_size, '\0');
+            for (;;) {
+                auto& body = parser->get().body();
+                body.data = chunk.data();
+                body.size = chunk.size();
+
+                boost::system::error_code ec;
+                conn->stream.expires_after(proxy->options_.timeout);
+                co_await http::async_read(
+                    conn->stream, conn->buffer, *parser, net_awaitable[ec]);
+                if (ec == http::error::need_buffer) ec = {};
+                if (ec) {
+                    // the body is cut short, the client must not take it as complete
+                    outcome = result::failure;
+                    conn.reset();
+                    throw boost::system::system_error(ec);
+                }
+
+                auto bytes = chunk.size() - body.size;
+                if (bytes == 0 && !parser->is_done()) continue;
+                if (parser->is_done()) reusable = parser->get().keep_alive();
+                chunk.resize(bytes);
+                co_return chunk;
+            }
+        }
+
+        enum class result { success, failure, none };
+
+        std::shared_ptr<impl> proxy;
+        std::size_t index;
+        std::unique_ptr<connection> conn;
+        std::optional<http::response_parser<http::buffer_body>> parser;
+        bool reusable = false;
+        result outcome = result::none;
+    };
+
+public:
+    impl(std::vector<reverse_proxy::upstream> upstreams,
+         const reverse_proxy::options& opts)
+        : options_(opts) {
+        for (auto& target : upstreams)
+            nodes_.push_back(node {std::move(target)});
+
+        for (std::size_t i = 0; i < nodes_.size(); ++i) {
+            const auto& target = nodes_[i].target;
+            for (std::size_t v = 0; v < virtual_nodes; ++v) {
+                auto point = fmt::format("{}:{}#{}", target.host, target.port, v);
+                ring_.emplace_back(std::hash<std::string> {}(point), i);
+            }
+        }
+        std::sort(ring_.begin(), ring_.end());
+    }
+
+    net::awaitable<void> forward(request& req, response& resp, body_reader& body) {
+        if (nodes_.empty()) {
+            resp.set_error_content(http::status::bad_gateway);
+            co_return;
+        }
+        auto state = std::make_shared<exchange>(shared_from_this(), pick(req));
+
+        http::request<http::buffer_body> out;
+        out.method_string(req.method_string());
+        out.target(req.target());
+        out.version(11);
+        copy_end_to_end(req.base(), out.base());
+        // the session already answered any 100-continue
+        out.erase(http::field::expect);
+        auto client = req.remote_endpoint.address().to_string();
+        std::string_view forwarded = req[http::field::x_forwarded_for];
+        out.set(http::field::x_forwarded_for,
+                forwarded.empty() ? client : fmt::format("{}, {}", forwarded, client));
+        bool has_body = req.has_content_length() || req.chunked();
+        if (req.chunked()) out.chunked(true);
+
+        boost::system::error_code ec;
+        bool body_started = false;
+        for (bool retried = false;; retried = true) {
+            bool reused = false;
+            state->conn = co_await connect(state->index, reused, ec);
+            if (!state->conn) {
+                state->outcome = exchange::result::failure;
+                resp.set_error_content(gateway_error(ec));
+                co_return;
+            }
+
+            bool client_failed = false;
+            co_await send_request(*state->conn,
+                                  out,
+                                  has_body ? &body : nullptr,
+                                  body_started,
+                                  client_failed,
+                                  ec);
+            if (client_failed) {
+                resp.set_error_content(ec == http::error::body_limit
+                                           ? http::status::payload_too_large
+                                           : http::status::bad_request);
+                co_return;
+            }
+            // with no body bytes taken, a failure up to here was the header write
+            bool delivered = !ec;
+            if (!ec) {
+                state->parser.emplace();
+                state->parser->body_limit(boost::none);
+                if (req.method() == http::verb::head) state->parser->skip(true);
+                state->conn->stream.expires_after(options_.timeout);
+                co_await http::async_read_header(state->conn->stream,
+                                                 state->conn->buffer,
+                                                 *state->parser,
+                                                 net_awaitable[ec]);
+            }
+            if (!ec) break;
+
+            // a kept-alive connection the upstream closed in the meantime, try once
+            // more on a fresh one as long as no body bytes are gone. A request the
+            // upstream may already have processed is only sent again when that is
+            // harmless.
+            state->conn.reset();
+            if (reused && !body_started && !retried &&
+                (!delivered || is_idempotent(req.method())))
+                continue;
+            state->outcome = exchange::result::failure;
+            resp.set_error_content(gateway_error(ec));
+            co_return;
+        }
+
+        const auto& in = state->parser->get();
+        auto status = in.result_int();
+        state->outcome = status == 502 || status == 503 || status == 504
+                             ? exchange::result::failure
+                             : exchange::result::success;
+
+        resp.result(in.result());
+        copy_end_to_end(in.base(), resp.base());
+
+        if (state->parser->is_done()) {
+            // no body, or none for this request: keep the upstream's Content-Length
+            state->reusable = in.keep_alive();
+            resp.body() = body::empty_body::value_type {};
+            co_return;
+        }
+        auto length = state->parser->content_length();
+        resp.set_stream_content([state]() { return state->read_some(); },
+                                in[http::field::content_type],
+                                in.result());
+        // already encoded by the upstream, the bytes must go out untouched
+        if (in.count(http::field::content_encoding)) resp.body().set_encoded(true);
+        if (length) {
+            resp.chunked(false);
+            resp.content_length(*length);
+        }
+    }
+
+    std::size_t healthy_count() const {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lck(mtx_);
+        return std::count_if(nodes_.begin(), nodes_.end(), [&](const node& n) {
+            return n.ejected_until <= now;
+        });
+    }
+
+private:
+    // RFC 9110, 9.2.2
+    static bool is_idempotent(http::verb method) {
+        switch (method) {
+            case http::verb::get:
+            case http::verb::head:
+            case http::verb::options:
+            case http::verb::trace:
+            case http::verb::put:
+            case http::verb::delete_: return true;
+            default: return false;
+        }
+    }
+
+    static http::status gateway_error(const boost::system::error_code& ec) {
+        return ec == beast::error::timeout ? http::status::gateway_timeout
+                                           : http::status::bad_gateway;
+    }
+
+    std::size_t pick(const request& req) {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lck(mtx_);
+        bool any_healthy = std::any_of(nodes_.begin(), nodes_.end(), [&](const node& n) {
+            return n.ejected_until <= now;
+        });
+        // with every upstream ejected, spreading the load beats failing everything
+        auto usable = [&](std::size_t i) {
+            return !any_healthy || nodes_[i].ejected_until <= now;
+        };
+
+        std::size_t chosen = 0;
+        switch (options_.policy) {
+            case reverse_proxy::balance::round_robin:
+                for (std::size_t k = 0; k < nodes_.size(); ++k) {
+                    chosen = (next_ + k) % nodes_.size();
+                    if (usable(chosen)) break;
+                }
+                next_ = chosen + 1;
+                break;
+            case reverse_proxy::balance::least_connections: {
+                // scanning from a moving start spreads the ties
+                std::optional<std::size_t> best;
+                for (std::size_t k = 0; k < nodes_.size(); ++k) {
+                    auto i = (next_ + k) % nodes_.size();
+                    if (usable(i) && (!best || nodes_[i].active < nodes_[*best].active))
+                        best = i;
+                }
+                chosen = best.value_or(0);
+                next_ = chosen + 1;
+            } break;
+            case reverse_proxy::balance::consistent_hash: {
+                auto key = std::string(req[options_.hash_header]);
+                if (options_.hash_header.empty() || key.empty())
+                    key = req.remote_endpoint.address().to_string();
+                std::pair<std::size_t, std::size_t> point {std::hash<std::string> {}(key),
+                                                           0};
+                auto iter = std::lower_bound(ring_.begin(), ring_.end(), point);
+                for (std::size_t k = 0; k < ring_.size(); ++k, ++iter) {
+                    if (iter == ring_.end()) iter = ring_.begin();
+                    chosen = iter->second;
+                    if (usable(chosen)) break;
+                }
+            } break;
+        }
+        nodes_[chosen].active++;
+        return chosen;
+    }
+
+    net::awaitable<std::unique_ptr<connection>>
+    connect(std::size_t index, bool& reused, boost::system::error_code& ec) {
+        ec = {};
+        // closed outside the lock
+        std::vector<std::unique_ptr<connection>> dropped;
+        {
+            auto now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lck(mtx_);
+            auto& idle = nodes_[index].idle;
+            while (!idle.empty()) {
+                auto conn = std::move(idle.back());
+                idle.pop_back();
+                if (now - conn->idle_since < options_.idle_timeout &&
+                    is_socket_alive(conn->stream.socket())) {
+                    reused = true;
+                    co_return conn;
+                }
+                dropped.push_back(std::move(conn));
+            }
+        }
+        reused = false;
+
+        auto ex = co_await net::this_coro::executor;
+        const auto& target = nodes_[index].target;
+        auto endpoints = co_await dns_cache::instance().async_resolve(
+            target.host, std::to_string(target.port), ec);
+        if (ec) co_return nullptr;
+
+        auto conn = std::make_unique<connection>(ex);
+        co_await async_connect_staggered(conn->stream.socket(),
+                                         endpoints,
+                                         options_.connect_attempt_delay,
+                                         options_.connect_timeout,
+                                         ec);
+        if (ec) co_return nullptr;
+        co_return conn;
+    }
+
+    net::awaitable<void> send_request(connection& conn,
+                                      http::request<http::buffer_body>& out,
+                                      body_reader* body,
+                                      bool& body_started,
+                                      bool& client_failed,
+                                      boost::system::error_code& ec) {
+        http::request_serializer<http::buffer_body> serializer(out);
+        conn.stream.expires_after(options_.timeout);
+        co_await http::async_write_header(conn.stream, serializer, net_awaitable[ec]);
+        if (ec || !body) co_return;
+
+        std::string buffer(chunk_size, '\0');
+        for (;;) {
+            auto bytes = co_await body->async_read_some(net::buffer(buffer), ec);
+            if (ec) {
+                client_failed = true;
+                co_return;
+            }
+            body_started = true;
+            out.body().data = bytes != 0 ? buffer.data() : nullptr;
+            out.body().size = bytes;
+            out.body().more = bytes != 0;
+
+            conn.stream.expires_after(options_.timeout);
+            co_await http::async_write(conn.stream, serializer, net_awaitable[ec]);
+            if (ec == http::error::need_buffer) ec = {};
+            if (ec || bytes == 0) co_return;
+        }
+    }
+
+    void release(std::size_t index,
+                 std::unique_ptr<connection> conn,
+                 exchange::result outcome) {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lck(mtx_);
+        auto& n = nodes_[index];
+        n.active--;
+
+        if (outcome == exchange::result::failure) {
+            if (++n.failures >= options_.max_failures) eject(n, now);
+        } else if (outcome == exchange::result::success) {
+            n.failures = 0;
+            // healthy for a whole ejection period since it came back
+            if (now >= n.ejected_until + options_.ejection_time) n.ejections = 0;
+        }
+
+        if (conn && n.idle.size() < options_.max_idle_per_upstream) {
+            conn->stream.expires_never();
+            conn->idle_since = now;
+            n.idle.push_back(std::move(conn));
+        }
+    }
+
+    void eject(node& n, std::chrono::steady_clock::time_point now) {
+        auto ejected = std::count_if(nodes_.begin(), nodes_.end(), [&](const node& o) {
+            return o.ejected_until > now;
+        });
+        if (ejected + 1 > options_.max_ejection_ratio * nodes_.size()) return;
+
+        n.ejected_until = now + options_.ejection_time * (1 << std::min(n.ejections, 3u));
+        n.ejections++;
+        n.failures = 0;
+        n.idle.clear();
+    }
+
+    const reverse_proxy::options options_;
+
+    mutable std::mutex mtx_;
+    // fixed after construction, only the fields of the nodes change
+    std::vector<node> nodes_;
+    // hash points and the node they belong to, sorted
+    std::vector<std::pair<std::size_t, std::size_t>> ring_;
+    std::size_t next_ = 0;
+};
+
+reverse_proxy::reverse_proxy(std::vector<upstream> upstreams, const options& opts)
+    : impl_(std::make_shared<impl>(std::move(upstreams), opts)) { }
+reverse_proxy::reverse_proxy(std::vector<upstream> upstreams)
+    : reverse_proxy(std::move(upstreams), options {}) { }
+reverse_proxy::~reverse_proxy() = default;
+
+net::awaitable<void>
+reverse_proxy::operator()(request& req, response& resp, body_reader& body) const {
+    co_await impl_->forward(req, resp, body);
+}
+
+std::size_t reverse_proxy::healthy_count() const { return impl_->healthy_count(); }
+
+} // namespace httplib
@@ -4,11 +4,19 @@
 #include "httplib/http_handler.hpp"
 #include "httplib/setting.hpp"
 #include "httplib/util/type_traits.h"
+#include "body/compressor.hpp"
+#include "compressed_cache.hpp"
+#include "file_cache.hpp"
 #include "radix_tree.hpp"
+#include "regex_matcher.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/beast/version.hpp>
+#include <fmt/format.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <functional>
-#include <regex>
+#include <mutex>
 #include <set>
 #include <spdlog/spdlog.h>
 #include <tuple>
@@ -58,23 +66,80 @@ inline static bool is_valid_path(std::string_view path) {
     return true;
 }
 
-static std::string make_whole_str(http::verb method, std::string_view target) {
-    return fmt::format("{} {}", std::string_view(http::to_string(method)), target);
+// value of the Allow header for a radix_tree::lookup_result::allowed mask
+static std::string format_allow(std::uint64_t allowed) {
+    std::string value;
+    for (std::size_t i = 0; i < radix_tree::verb_count; ++i) {
+        if (!(allowed & (std::uint64_t(1) << i))) continue;
+        if (!value.empty()) value += ", ";
+        value += http::to_string(static_cast<http::verb>(i));
+    }
+    return value;
 }
-static std::string make_whole_str(const request& req) {
-    return make_whole_str(req.base().method(), util::url_decode(req.target()));
+
+static std::shared_ptr<const std::string>
+compress(const std::string& encoding, int level, std::string_view data) {
+    std::string out;
+    if (!body::compress(encoding, level, data, out)) return nullptr;
+    return std::make_shared<const std::string>(std::move(out));
 }
 
 } // namespace detail
 
+// Everything routing reads. A published table is never modified again: writers copy
+// the current one, change the copy and swap it in, readers keep the snapshot they
+// loaded alive for as long as the request uses it.
+struct route_table {
+    using verb_handler_map = std::unordered_map<http::verb, coro_handler_t>;
+    // transparent so string_view paths are looked up without a copy
+    struct path_hash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view path) const noexcept {
+            return std::hash<std::string_view> {}(path);
+        }
+    };
+    std::unordered_map<std::string, verb_handler_map, path_hash, std::equal_to<>>
+        coro_handles_;
+
+    radix_tree coro_router_tree_;
+    regex_matcher regex_routes_;
+
+    coro_http_handler_type default_handler_;
+    coro_http_handler_type file_request_handler_;
+
+    struct mount_point_entry {
+        std::string mount_point;
+        fs::path base_dir;
+        http::fields headers;
+        // look for ".br", ".zst" and ".gz" files next to the requested one
+        bool precompressed = false;
+    };
+    std::vector<mount_point_entry> static_file_entry_;
+};
+
 class router::impl {
 public:
-    impl(const server::setting& option) : option_(option) { }
+    impl(const server::setting& option)
+        : option_(option), table_(std::make_shared<const route_table>()) { }
+
+    std::shared_ptr<const route_table> table() const { return table_.load(); }
+
+    // Runs `update` on a copy of the current table and publishes the copy. Writers are
+    // serialized, readers never wait for them.
+    template<typename Func>
+    auto update(Func&& update) {
+        std::lock_guard<std::mutex> lck(write_mtx_);
+        auto next = std::make_shared<route_table>(*table_.load());
+        auto result = update(*next);
+        table_.store(std::move(next));
+        return result;
+    }
 
-    net::awaitable<bool> handle_file_request(request& req, response& res) {
-        beast::error_code ec;
+    net::awaitable<bool>
+    handle_file_request(const route_table& table, request& req, response& res) {
+        auto& cache = file_cache::instance();
 
-        for (const auto& entry : static_file_entry_) {
+        for (const auto& entry : table.static_file_entry_) {
             std::string_view target(req.path);
             // Prefix match
             if (!target.starts_with(entry.mount_point)) continue;
@@ -84,7 +149,8 @@ public:
             auto path = entry.base_dir /
                         fs::path(std::u8string_view((const char8_t*)target.data(),
                                                     target.size()));
-            if (!fs::exists(path, ec)) continue;
+            auto info = cache.stat(path);
+            if (info->type == fs::file_type::not_found) continue;
 
             if (target.empty() && !req.path.ends_with("/")) {
                 res.set_redirect(req.path + "/");
@@ -94,114 +160,226 @@ public:
             if (!path.has_filename()) {
                 for (const auto& doc_name : default_doc_name_) {
                     auto doc_path = path / doc_name;
-
-                    boost::system::error_code ec;
-                    if (!fs::is_regular_file(doc_path, ec)) continue;
+                    auto doc_info = cache.stat(doc_path);
+                    if (doc_info->type != fs::file_type::regular) continue;
 
                     path = doc_path;
+                    info = doc_info;
                     break;
                 }
             }
             if (path.has_filename()) {
-                if (fs::is_regular_file(path, ec)) {
+                if (info->type == fs::file_type::regular) {
                     for (const auto& kv : entry.headers) {
                         res.base().set(kv.name_string(), kv.value());
                     }
-                    res.set_file_content(path, req);
-                    if (req.method() != http::verb::head && file_request_handler_) {
-                        co_await file_request_handler_(req, res);
+                    bool done =
+                        entry.precompressed && set_precompressed(path, *info, req, res);
+                    if (!done) done = set_cached_compressed(path, *info, req, res);
+                    if (!done) res.set_file_content(path, req);
+                    const auto& file_handler = table.file_request_handler_;
+                    if (req.method() != http::verb::head && file_handler) {
+                        co_await file_handler(req, res);
                     }
 
                     co_return true;
                 }
-            } else if (fs::is_directory(path, ec)) {
+            } else if (info->type == fs::file_type::directory) {
                 beast::error_code ec;
                 auto body = html::format_dir_to_html(req.path, path, ec);
                 if (ec) co_return false;
-                res.set_string_content(body, "text/html; charset=utf-8");
+                if (!set_cached_listing(body, req, res))
+                    res.set_string_content(body, "text/html; charset=utf-8");
                 co_return true;
             }
         }
 
         co_return false;
     }
-    net::awaitable<void> proc_routing(request& req, response& resp) {
+    // Serves the precompressed copy of `path` the client weighs highest, ties go by
+    // the order below. A copy older than the file is ignored.
+    static bool set_precompressed(const fs::path& path,
+                                  const file_cache::entry& info,
+                                  const request& req,
+                                  response& res) {
+        static constexpr std::pair<std::string_view, std::string_view> sidecars[] = {
+            {"br", ".br"}, {"zstd", ".zst"}, {"gzip", ".gz"}};
+
+        // whichever representation is chosen, it depends on Accept-Encoding
+        res.set(http::field::vary, "Accept-Encoding");
+        auto accept = req[http::field::accept_encoding];
+        if (accept.empty()) return false;
+
+        std::array<std::pair<float, std::size_t>, std::size(sidecars)> candidates;
+        for (std::size_t i = 0; i < candidates.size(); ++i)
+            candidates[i] = {body::accept_encoding_weight(accept, sidecars[i].first), i};
+        std::stable_sort(candidates.begin(),
+                         candidates.end(),
+                         [](const auto& l, const auto& r) { return l.first > r.first; });
+
+        for (const auto& [weight, index] : candidates) {
+            if (weight <= 0) break;
+            const auto& [coding, extension] = sidecars[index];
+            auto sidecar = path;
+            sidecar += extension;
+            auto sidecar_info = file_cache::instance().stat(sidecar);
+            if (sidecar_info->type != fs::file_type::regular) continue;
+            if (sidecar_info->last_write_time < info.last_write_time) continue;
+
+            res.set_file_content(sidecar, req, coding, info.content_type);
+            return true;
+        }
+        return false;
+    }
+    // the encoding option_.compression picks for this content, empty for none
+    std::string negotiate_encoding(const request& req,
+                                   std::string_view content_type,
+                                   std::uint64_t size) const {
+        const auto& policy = option_.compression;
+        if (!policy.is_compressible(content_type, size)) return {};
+        auto accept = req[http::field::accept_encoding];
+        return std::string(body::negotiate_encoding(accept, policy.encodings));
+    }
+    // Serves a small file from its compressed copy in compressed_cache, compressing it
+    // and offering it to the cache on a miss. Range requests take the plain file path.
+    bool set_cached_compressed(const fs::path& path,
+                               const file_cache::entry& info,
+                               const request& req,
+                               response& res) const {
+        auto budget = option_.compressed_cache_size;
+        if (budget == 0 || !info.file) return false;
+        if (info.size > option_.compressed_cache_max_file_size) return false;
+        if (req.count(http::field::range)) return false;
+        auto encoding = negotiate_encoding(req, info.content_type, info.size);
+        if (encoding.empty()) return false;
+
+        // every representation needs a validator of its own
+        auto etag = fmt::format("{}-{}", info.etag, encoding);
+        res.set(http::field::vary, "Accept-Encoding");
+        if (html::is_not_modified(req[http::field::if_none_match],
+                                  req[http::field::if_modified_since],
+                                  etag,
+                                  info.last_modified)) {
+            res.set(http::field::etag, etag);
+            res.set_empty_content(http::status::not_modified);
+            return true;
+        }
+
+        auto key = fmt::format(
+            "{}\n{}\n{}\n{}", path.string(), info.size, info.last_write_time, encoding);
+        auto& cache = compressed_cache::instance();
+        auto data   = cache.find(key);
+        if (!data) {
+            std::string content(info.size, '\0');
+            std::size_t offset = 0;
+            while (offset < content.size()) {
+                boost::system::error_code ec;
+                auto n = info.file->read_at(
+                    offset, content.data() + offset, content.size() - offset, ec);
+                if (ec || n == 0) return false;
+                offset += n;
+            }
+            auto level = option_.compression.level(encoding);
+            data       = detail::compress(encoding, level, content);
+            if (!data) return false;
+            cache.insert(key, data, budget);
+        }
+
+        res.set(http::field::etag, etag);
+        res.set(http::field::last_modified, info.last_modified);
+        res.set(http::field::content_encoding, encoding);
+        res.set_shared_content(std::move(data), info.content_type);
+        res.body().set_encoded(true);
+        return true;
+    }
+    // Directory listings are generated on every request, only their compression is
+    // cached, keyed by the content itself.
+    bool set_cached_listing(const std::string& listing,
+                            const request& req,
+                            response& res) const {
+        auto budget = option_.compressed_cache_size;
+        if (budget == 0 || listing.size() > option_.compressed_cache_max_file_size)
+            return false;
+        auto encoding = negotiate_encoding(req, "text/html", listing.size());
+        if (encoding.empty()) return false;
+
+        auto key = fmt::format("listing\n{}\n{}\n{}\n{}",
+                               req.path,
+                               std::hash<std::string_view> {}(listing),
+                               listing.size(),
+                               encoding);
+        auto& cache = compressed_cache::instance();
+        auto data   = cache.find(key);
+        if (!data) {
+            auto level = option_.compression.level(encoding);
+            data       = detail::compress(encoding, level, listing);
+            if (!data) return false;
+            cache.insert(key, data, budget);
+        }
+
+        res.set(http::field::vary, "Accept-Encoding");
+        res.set(http::field::content_encoding, encoding);
+        res.set_shared_content(std::move(data), "text/html; charset=utf-8");
+        res.body().set_encoded(true);
+        return true;
+    }
+    net::awaitable<void>
+    proc_routing(const route_table& table, request& req, response& resp) {
         if (req.method() == http::verb::get || req.method() == http::verb::head) {
-            if (co_await handle_file_request(req, resp)) co_return;
+            if (co_await handle_file_request(table, req, resp)) co_return;
         }
 
         {
-            auto iter = coro_handles_.find(req.path);
-            if (iter != coro_handles_.end()) {
+            auto iter = table.coro_handles_.find(req.path);
+            if (iter != table.coro_handles_.end()) {
                 const auto& map = iter->second;
                 auto iter = map.find(req.method());
                 if (iter != map.end()) {
-                    co_await iter->second(req, resp);
+                    co_await iter->second.coro_handler(req, resp);
                     co_return;
                 } else {
+                    std::uint64_t allowed = 0;
+                    for (const auto& [method, route] : map)
+                        allowed |= std::uint64_t(1) << static_cast<std::size_t>(method);
                     resp.set_error_content(http::status::method_not_allowed);
+                    resp.set(http::field::allow, detail::format_allow(allowed));
                     co_return;
                 }
             }
         }
-        if (default_handler_) {
-            co_await default_handler_(req, resp);
+        if (table.default_handler_) {
+            co_await table.default_handler_(req, resp);
             co_return;
         }
-        auto key = detail::make_whole_str(req);
-        std::string url_path = detail::make_whole_str(req.method(), req.target());
+        auto result =
+            table.coro_router_tree_.find(req.path, req.method(), req.path_params);
 
-        bool is_coro_exist = false;
-        coro_http_handler_type coro_handler;
-        std::tie(is_coro_exist, coro_handler, req.path_params) =
-            coro_router_tree_->get_coro(url_path, req.method());
-
-        if (is_coro_exist) {
-            if (coro_handler) {
-                co_await coro_handler(req, resp);
+        if (result.path_matched) {
+            if (result.route) {
+                co_await result.route->coro_handler(req, resp);
             } else {
-                resp.set_error_content(http::status::not_found);
+                resp.set_error_content(http::status::method_not_allowed);
+                resp.set(http::field::allow, detail::format_allow(result.allowed));
             }
             co_return;
         }
-        bool is_matched_regex_router = false;
         // coro regex router
-        for (auto& pair : coro_regex_handles_) {
-            std::string coro_regex_key {key};
-
-            if (std::regex_match(coro_regex_key, req.matches, std::get<0>(pair))) {
-                auto coro_handler = std::get<1>(pair);
-                if (coro_handler) {
-                    co_await coro_handler(req, resp);
-                    is_matched_regex_router = true;
-                }
-            }
+        const auto& regex_routes = table.regex_routes_;
+        if (auto route = regex_routes.match(req.method(), req.path, &req.matches)) {
+            co_await route->handler(req, resp);
+            co_return;
         }
 
         // not found
-        if (!is_matched_regex_router) { resp.set_error_content(http::status::not_found); }
+        resp.set_error_content(http::status::not_found);
         co_return;
     }
 
 public:
     const server::setting& option_;
 
-    using verb_handler_map = std::unordered_map<http::verb, coro_http_handler_type>;
-    std::unordered_map<std::string, verb_handler_map> coro_handles_;
-
-    std::shared_ptr<radix_tree> coro_router_tree_ =
-        std::make_shared<radix_tree>(radix_tree());
-    std::vector<std::tuple<std::regex, coro_http_handler_type>> coro_regex_handles_;
-
-    coro_http_handler_type default_handler_;
-    coro_http_handler_type file_request_handler_;
-
-    struct mount_point_entry {
-        std::string mount_point;
-        fs::path base_dir;
-        http::fields headers;
-    };
-    std::vector<mount_point_entry> static_file_entry_;
+    std::mutex write_mtx_;
+    std::atomic<std::shared_ptr<const route_table>> table_;
 
     std::vector<std::string> default_doc_name_ = {"index.html", "index.htm"};
 };
@@ -210,25 +388,81 @@ router::~router() {
     // delete impl_;
 }
 bool router::has_handler(http::verb method, std::string_view target) const {
-    return true;
+    route_info info;
+    return has_handler(method, target, info);
+}
+bool router::has_handler(http::verb method,
+                         std::string_view target,
+                         route_info& info) const {
+    info = {};
+    auto table = impl_->table();
+    info.snapshot = table;
+    auto found = [&](const route_info& route) {
+        info = route;
+        info.snapshot = table;
+        return true;
+    };
+
+    // the same path routing() matches: split off the query, then decode, which only
+    // needs a copy when there is something to decode
+    std::string_view path = target.substr(0, target.find('?'));
+    std::string decoded_path;
+    if (path.find('%') != std::string_view::npos) {
+        decoded_path = util::url_decode(path);
+        path = decoded_path;
+    }
+
+    // the lookups follow proc_routing(): a missing static file falls through to the
+    // routes, so the route found behind a mount point still decides the body handling
+    bool mounted = false;
+    if (method == http::verb::get || method == http::verb::head) {
+        for (const auto& entry : table->static_file_entry_) {
+            if (path.starts_with(entry.mount_point)) mounted = true;
+        }
+    }
+
+    auto iter = table->coro_handles_.find(path);
+    if (iter != table->coro_handles_.end()) {
+        auto route = iter->second.find(method);
+        if (route == iter->second.end()) return mounted;
+        return found(route->second.info);
+    }
+
+    if (table->default_handler_) return true;
+
+    route_params params;
+    auto result = table->coro_router_tree_.find(path, method, params);
+    if (result.path_matched) {
+        if (!result.route) return mounted;
+        return found(result.route->info);
+    }
+
+    if (auto route = table->regex_routes_.match(method, path, nullptr))
+        return found(route->info);
+    return mounted;
 }
 net::awaitable<void> router::routing(request& req, response& resp) {
     try {
-        auto tokens = util::split(req.target(), "?");
-        if (tokens.empty() || tokens.size() > 2) {
+        // the decoded path is the only copy made of the target, query params are
+        // validated here and parsed by request::query_params() when a handler asks
+        std::string_view target = req.target();
+        auto query_pos = target.find('?');
+        // a second '?' is malformed, as it always was
+        if (query_pos != std::string_view::npos &&
+            (target.find('?', query_pos + 1) != std::string_view::npos ||
+             !html::is_valid_http_query_params(target.substr(query_pos + 1)))) {
             resp.set_empty_content(http::status::bad_request);
             co_return;
         }
-        req.path = util::url_decode(tokens[0]);
-        if (tokens.size() >= 2) {
-            bool is_valid = true;
-            req.query_params = html::parse_http_query_params(tokens[1], is_valid);
-            if (!is_valid) {
-                resp.set_empty_content(http::status::bad_request);
-                co_return;
-            }
-        }
-        co_await impl_->proc_routing(req, resp);
+        req.path.assign(target.substr(0, query_pos));
+        if (req.path.find('%') != std::string::npos) util::url_decode(req.path);
+
+        // held until the handler is done, path params and matches point into it; the
+        // session hands over the snapshot has_handler() decided the body handling on
+        auto table = req.route_snapshot
+                         ? std::static_pointer_cast<const route_table>(req.route_snapshot)
+                         : impl_->table();
+        co_await impl_->proc_routing(*table, req, resp);
     } catch (const std::exception& e) {
         impl_->option_.get_logger()->warn("exception in business function, reason: {}",
                                           e.what());
@@ -243,17 +477,21 @@ net::awaitable<void> router::routing(request& req, response& resp) {
 }
 bool router::set_mount_point(const std::string& mount_point,
                              const fs::path& dir,
-                             const http::fields& headers /*= {}*/) {
+                             const http::fields& headers /*= {}*/,
+                             bool precompressed /*= false*/) {
     if (fs::is_directory(dir)) {
         std::string mnt = !mount_point.empty() ? mount_point : "/";
         if (!mnt.empty() && mnt[0] == '/') {
-            impl_->static_file_entry_.push_back({mnt, dir, headers});
-            std::sort(impl_->static_file_entry_.begin(),
-                      impl_->static_file_entry_.end(),
-                      [](const auto& left, const auto& right) {
-                          return left.mount_point.size() > right.mount_point.size();
-                      });
-            return true;
+            return impl_->update([&](route_table& table) {
+                auto& entries = table.static_file_entry_;
+                entries.push_back({mnt, dir, headers, precompressed});
+                std::sort(entries.begin(),
+                          entries.end(),
+                          [](const auto& left, const auto& right) {
+                              return left.mount_point.size() > right.mount_point.size();
+                          });
+                return true;
+            });
         }
     }
     impl_->option_.get_logger()->warn("set_mount_point path: {} is not directory",
@@ -261,55 +499,69 @@ bool router::set_mount_point(const std::string& mount_point,
     return false;
 }
 bool router::remove_mount_point(const std::string& mount_point) {
-    for (auto it = impl_->static_file_entry_.begin();
-         it != impl_->static_file_entry_.end();
-         ++it) {
-        if (it->mount_point == mount_point) {
-            impl_->static_file_entry_.erase(it);
-            return true;
+    return impl_->update([&](route_table& table) {
+        auto& entries = table.static_file_entry_;
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->mount_point == mount_point) {
+                entries.erase(it);
+                return true;
+            }
         }
-    }
-    return false;
+        return false;
+    });
 }
 
 void router::set_http_handler_impl(http::verb method,
                                    std::string_view key,
-                                   coro_http_handler_type&& handler) {
-    auto whole_str = detail::make_whole_str(method, key);
+                                   coro_http_handler_type&& handler,
+                                   const route_info& info) {
+    impl_->update([&](route_table& table) {
+        if (key.find(":") != std::string::npos) {
+            if (!table.coro_router_tree_.insert(key, std::move(handler), method, info)) {
+                impl_->option_.get_logger()->warn(
+                    R"(router method: {} key: {} conflicts with a registered route.)",
+                    http::to_string(method),
+                    key);
+            }
+            return true;
+        }
 
-    if (whole_str.find(":") != std::string::npos) {
-        impl_->coro_router_tree_->coro_insert(whole_str, std::move(handler), method);
-        return;
-    }
+        if (key.find("{") != std::string::npos || key.find(")") != std::string::npos) {
+            // regex routes match the decoded path only, without the verb and query
+            std::string pattern(key);
 
-    if (whole_str.find("{") != std::string::npos ||
-        whole_str.find(")") != std::string::npos) {
-        std::string pattern = whole_str;
+            if (pattern.find("{}") != std::string::npos) {
+                boost::replace_all(pattern, "{}", "([^/]+)");
+            }
 
-        if (pattern.find("{}") != std::string::npos) {
-            boost::replace_all(pattern, "{}", "([^/]+)");
+            table.regex_routes_.add(method, pattern, std::move(handler), info);
+            return true;
         }
-
-        impl_->coro_regex_handles_.emplace_back(std::regex(pattern), std::move(handler));
-        return;
-    }
-    auto& map = impl_->coro_handles_[std::string(key)];
-    if (map.count(method)) {
-        impl_->option_.get_logger()->warn(
-            R"(router method: {} key: {} has already registered.)",
-            http::to_string(method),
-            key);
-        return;
-    }
-    map[method] = std::move(handler);
+        auto& map = table.coro_handles_[std::string(key)];
+        if (map.count(method)) {
+            impl_->option_.get_logger()->warn(
+                R"(router method: {} key: {} has already registered.)",
+                http::to_string(method),
+                key);
+            return false;
+        }
+        map[method] = coro_handler_t {method, std::move(handler), info};
+        return true;
+    });
 }
 
 void router::set_default_handler_impl(coro_http_handler_type&& handler) {
-    impl_->default_handler_ = std::move(handler);
+    impl_->update([&](route_table& table) {
+        table.default_handler_ = std::move(handler);
+        return true;
+    });
 }
 
 void router::set_file_request_handler_impl(coro_http_handler_type&& handler) {
-    impl_->file_request_handler_ = std::move(handler);
+    impl_->update([&](route_table& table) {
+        table.file_request_handler_ = std::move(handler);
+        return true;
+    });
 }
 
 } // namespace httplib
\ No newline at end of file
@@ -1,44 +1,175 @@
-
 #include "httplib/server.hpp"
 
 #include "httplib/router.hpp"
 #include "httplib/setting.hpp"
+#include "buffer_pool.hpp"
+#include "file_cache.hpp"
 #include "session.hpp"
+#include "session_registry.hpp"
+#include "ssl_context_manager.hpp"
 #include <boost/asio/co_spawn.hpp>
 #include <boost/asio/detached.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <optional>
 #include <span>
 #include <spdlog/spdlog.h>
-#include <unordered_set>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace httplib {
 using namespace std::chrono_literals;
 
+namespace detail {
+#ifdef SO_REUSEPORT
+using reuse_port = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+static void pin_thread_to_core(std::thread& thread, uint32_t index) {
+#ifdef __linux__
+    auto cores = std::thread::hardware_concurrency();
+    if (cores == 0) return;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(index % cores, &cpuset);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+#endif
+}
+} // namespace detail
+
 class server::impl {
 public:
-    impl(uint32_t num_threads)
-        : pool(num_threads), acceptor(pool), router(this->option) { }
+    struct shard {
+        shard() : ioc(1), acceptor(ioc), work(ioc.get_executor()) { }
+
+        net::io_context ioc;
+        tcp::acceptor acceptor;
+        net::executor_work_guard<net::io_context::executor_type> work;
+        std::thread thread;
+    };
+
+    impl(uint32_t num_threads, io_model model)
+        : router(this->option)
+        , ssl_contexts(this->option)
+        , sessions((std::max)(num_threads, 1u)) {
+        num_threads = (std::max)(num_threads, 1u);
+        if (model == io_model::shared_pool) {
+            pool.emplace(num_threads);
+            acceptor.emplace(*pool);
+            return;
+        }
+        for (uint32_t i = 0; i < num_threads; ++i) {
+            auto& s = shards.emplace_back(std::make_unique<shard>());
+            s->thread = std::thread([ioc = &s->ioc]() { ioc->run(); });
+            detail::pin_thread_to_core(s->thread, i);
+        }
+    }
+    ~impl() {
+        for (auto& s : shards) {
+            s->work.reset();
+            s->ioc.stop();
+            if (s->thread.joinable()) s->thread.join();
+        }
+    }
+
+    net::any_io_executor next_shard_executor() {
+        auto index = next_shard.fetch_add(1, std::memory_order_relaxed) % shards.size();
+        return shards[index]->ioc.get_executor();
+    }
+
+    void listen_shards(const tcp::endpoint& endp, int backlog) {
+        auto bind_endp = endp;
+#ifdef SO_REUSEPORT
+        for (auto& s : shards) {
+            s->acceptor.open(bind_endp.protocol());
+            s->acceptor.set_option(net::socket_base::reuse_address(true));
+            s->acceptor.set_option(detail::reuse_port(true));
+            s->acceptor.bind(bind_endp);
+            s->acceptor.listen(backlog);
+            // port 0 picks an ephemeral port, every other shard must join that one
+            bind_endp = s->acceptor.local_endpoint();
+        }
+#else
+        auto& s = shards.front();
+        s->acceptor.open(bind_endp.protocol());
+        s->acceptor.bind(bind_endp);
+        s->acceptor.listen(backlog);
+        option.get_logger()->warn(
+            "SO_REUSEPORT is not supported, the first shard accepts for all shards");
+#endif
+    }
+
+    void start_accept(tcp::acceptor& acceptor,
+                      std::function<net::any_io_executor()> next_executor) {
+        net::co_spawn(
+            acceptor.get_executor(),
+            [this, &acceptor, next_executor]() -> net::awaitable<void> {
+                boost::system::error_code ec;
+                for (;;) {
+                    tcp::socket sock(next_executor());
+                    co_await acceptor.async_accept(sock, net_awaitable[ec]);
+                    if (ec) {
+                        option.get_logger()->trace("async_accept: {}", ec.message());
+                        co_return;
+                    }
+                    auto executor = sock.get_executor();
+                    auto session = std::make_shared<httplib::session>(
+                        std::move(sock), option, router, &ssl_contexts);
+                    net::co_spawn(
+                        executor,
+                        [this, session]() mutable -> net::awaitable<void> {
+                            session_registry::registration registration(sessions,
+                                                                        *session);
+                            try {
+                                co_await session->run();
+                            } catch (const std::exception& e) {
+                                option.get_logger()->error(
+                                    "session::run() exception: {}", e.what());
+                            } catch (...) {
+                                option.get_logger()->error(
+                                    "session::run() unknown exception");
+                            }
+                        },
+                        net::detached);
+                }
+            },
+            net::detached);
+    }
 
 public:
     server::setting option;
     httplib::router router;
-    net::thread_pool pool;
-    tcp::acceptor acceptor;
-
-    std::mutex session_mtx;
-    std::unordered_set<std::shared_ptr<session>> session_map;
+    ssl_context_manager ssl_contexts;
+    // declared before the io contexts: tearing those down destroys pending session
+    // frames, which unregister themselves on the way out
+    session_registry sessions;
+
+    // io_model::shared_pool
+    std::optional<net::thread_pool> pool;
+    std::optional<tcp::acceptor> acceptor;
+
+    // io_model::shard_per_core
+    std::vector<std::unique_ptr<shard>> shards;
+    std::atomic_size_t next_shard = 0;
 };
 
-server::server(uint32_t num_threads) : impl_(new impl(num_threads)) { }
+server::server(uint32_t num_threads, io_model model)
+    : impl_(new impl(num_threads, model)) { }
 
 server::~server() { delete impl_; }
 
 net::any_io_executor server::get_executor() noexcept {
-    return impl_->pool.get_executor();
+    if (impl_->pool) return impl_->pool->get_executor();
+    return impl_->next_shard_executor();
 }
 
 
@@ -47,13 +178,17 @@ server::setting& server::option() { return impl_->option; }
 server& server::listen(std::string_view host,
                        uint16_t port,
                        int backlog /*= net::socket_base::max_listen_connections*/) {
-    tcp::resolver resolver(impl_->pool);
+    tcp::resolver resolver(get_executor());
     auto results = resolver.resolve(host, std::to_string(port));
 
     tcp::endpoint endp(*results.begin());
-    impl_->acceptor.open(endp.protocol());
-    impl_->acceptor.bind(endp);
-    impl_->acceptor.listen(backlog);
+    if (impl_->acceptor) {
+        impl_->acceptor->open(endp.protocol());
+        impl_->acceptor->bind(endp);
+        impl_->acceptor->listen(backlog);
+    } else {
+        impl_->listen_shards(endp, backlog);
+    }
     impl_->option.get_logger()->info(
         "Server Listen on: [{}:{}]", endp.address().to_string(), endp.port());
     return *this;
@@ -70,61 +205,50 @@ void server::run() {
 }
 
 void server::async_run() {
-    net::co_spawn(
-        impl_->pool,
-        [this]() -> net::awaitable<void> {
-            boost::system::error_code ec;
-            for (;;) {
-                tcp::socket sock(impl_->pool);
-                co_await impl_->acceptor.async_accept(sock, net_awaitable[ec]);
-                if (ec) {
-                    impl_->option.get_logger()->trace("async_accept: {}", ec.message());
-                    co_return;
-                }
-                auto session = std::make_shared<httplib::session>(
-                    std::move(sock), impl_->option, impl_->router);
-                net::co_spawn(
-                    impl_->pool,
-                    [this, session]() mutable -> net::awaitable<void> {
-                        {
-                            std::unique_lock<std::mutex> lck(impl_->session_mtx);
-                            impl_->session_map.insert(session);
-                        }
-                        try {
-                            co_await session->run();
-                        } catch (const std::exception& e) {
-                            impl_->option.get_logger()->error(
-                                "session::run() exception: {}", e.what());
-                        } catch (...) {
-                            impl_->option.get_logger()->error(
-                                "session::run() unknown exception");
-                        }
-                        {
-                            std::unique_lock<std::mutex> lck(impl_->session_mtx);
-                            impl_->session_map.erase(session);
-                        }
-                    },
-                    net::detached);
-            }
-        },
-        net::detached);
+    file_cache::instance().set_options({impl_->option.file_cache_size,
+                                        impl_->option.file_cache_ttl});
+    if (impl_->acceptor) {
+        impl_->start_accept(*impl_->acceptor,
+                            [this]() { return impl_->pool->get_executor(); });
+        return;
+    }
+    for (auto& s : impl_->shards) {
+        if (!s->acceptor.is_open()) continue;
+#ifdef SO_REUSEPORT
+        impl_->start_accept(s->acceptor,
+                            [ioc = &s->ioc]() { return ioc->get_executor(); });
+#else
+        impl_->start_accept(s->acceptor, [this]() { return impl_->next_shard_executor(); });
+#endif
+    }
 }
 
 void server::wait() {
-    impl_->pool.wait();
-    impl_->session_map.clear();
+    if (impl_->pool) impl_->pool->wait();
+    for (auto& s : impl_->shards) {
+        s->work.reset();
+        if (s->thread.joinable()) s->thread.join();
+    }
 }
 
 void server::stop() {
     boost::system::error_code ec;
-    impl_->acceptor.close(ec);
-    {
-        std::unique_lock<std::mutex> lck(impl_->session_mtx);
-        for (const auto& v : impl_->session_map)
-            v->abort();
-    }
-    impl_->pool.stop();
+    if (impl_->acceptor) impl_->acceptor->close(ec);
+    for (auto& s : impl_->shards)
+        s->acceptor.close(ec);
+    impl_->sessions.abort_all();
+    if (impl_->pool) impl_->pool->stop();
+    for (auto& s : impl_->shards)
+        s->ioc.stop();
+}
+std::size_t server::connection_count() const noexcept { return impl_->sessions.size(); }
+
+tls_handshake_stats server::tls_stats() const noexcept {
+    return impl_->ssl_contexts.stats();
 }
+
+buffer_pool_stats server::buffer_stats() const noexcept { return buffer_pool::stats(); }
+
 httplib::router& server::router() { return impl_->router; }
 
-} // namespace httplib
\ No newline at end of file
+} // namespace httplib
@@ -1,20 +1,31 @@
 #include "session.hpp"
 
 #include "body/compressor.hpp"
+#include "buffer_pool.hpp"
+#include "httplib/dns_cache.hpp"
 #include "httplib/response.hpp"
 #include "httplib/router.hpp"
 #include "httplib/server.hpp"
 #include "httplib/setting.hpp"
+#include "ssl_context_manager.hpp"
+#include "stream/happy_eyeballs.hpp"
+#include "stream/sendfile.hpp"
+#include "stream/splice.hpp"
 #include "websocket_conn_impl.hpp"
 #include <boost/asio/experimental/awaitable_operators.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/beast/core/detect_ssl.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/buffer_body.hpp>
+#include <boost/beast/http/chunk_encode.hpp>
 #include <boost/beast/http/empty_body.hpp>
 #include <boost/beast/http/parser.hpp>
 #include <boost/beast/http/read.hpp>
 #include <boost/beast/http/serializer.hpp>
+#include <boost/beast/http/write.hpp>
 #include <boost/beast/websocket/rfc6455.hpp>
+#include <boost/json/serialize.hpp>
+#include <charconv>
 
 namespace httplib {
 
@@ -30,60 +41,81 @@ httplib::response make_respone(const http::request<Body>& req) {
     resp.keep_alive(req.keep_alive());
     return resp;
 }
-#ifdef HTTPLIB_ENABLED_SSL
-static std::shared_ptr<ssl::context> create_ssl_context(const server::SSLConfig& ssl_conf,
-                                                        boost::system::error_code& ec) {
-    unsigned long ssl_options = ssl::context::default_workarounds |
-                                ssl::context::no_sslv2 | ssl::context::single_dh_use;
-
-    auto ssl_ctx = std::make_shared<ssl::context>(ssl::context::sslv23);
-    ssl_ctx->set_options(ssl_options, ec);
-    if (ec) return nullptr;
-
-    if (!ssl_conf.passwd.empty()) {
-        ssl_ctx->set_password_callback(
-            [pass = ssl_conf.passwd](auto, auto) { return pass; }, ec);
-        if (ec) return nullptr;
-    }
-    ssl_ctx->use_certificate_chain_file(ssl_conf.cert_file.string(), ec);
-    if (ec) return nullptr;
-
-    ssl_ctx->use_private_key_file(ssl_conf.key_file.string(), ssl::context::pem, ec);
-    if (ec) return nullptr;
 
-    return ssl_ctx;
+// Returns once `stream` has something to read, so an idle peer ties up no buffer.
+// TLS may hold decrypted data the socket knows nothing about, it is read right away.
+inline net::awaitable<void> async_wait_readable(tcp::socket& stream,
+                                                boost::system::error_code& ec) {
+    co_await stream.async_wait(tcp::socket::wait_read, net_awaitable[ec]);
+}
+inline net::awaitable<void> async_wait_readable(http_variant_stream_type& stream,
+                                                boost::system::error_code& ec) {
+    if (auto plain = std::get_if<http_stream>(&stream))
+        co_await plain->socket().async_wait(tcp::socket::wait_read, net_awaitable[ec]);
 }
-#endif
 
+// Copies `from` into `to` through buffer_pool buffers, held for one read and write
+// only. The size adapts to the throughput: a read that fills the buffer doubles the
+// next one, a read using less than a quarter of it halves it.
 template<typename S1, typename S2>
-net::awaitable<void> transfer(S1& from, S2& to, size_t& bytes_transferred) {
-    static constexpr int buffer_size = 512 * 1024;
-
-    bytes_transferred = 0;
-    std::vector<uint8_t> buffer(buffer_size);
+net::awaitable<void> transfer(S1& from, S2& to, std::uint64_t& bytes_transferred) {
+    std::size_t buffer_size = buffer_pool::min_size;
     boost::system::error_code ec;
 
     for (;;) {
-        auto bytes =
-            co_await from.async_read_some(net::buffer(buffer), net_awaitable[ec]);
+        co_await async_wait_readable(from, ec);
+        if (ec) {
+            to.shutdown(net::socket_base::shutdown_send, ec);
+            co_return;
+        }
+
+        auto buffer = buffer_pool::acquire(buffer_size);
+        auto bytes = co_await from.async_read_some(buffer.mutable_buffer(),
+                                                   net_awaitable[ec]);
         if (ec) {
             if (bytes > 0)
                 co_await net::async_write(
-                    to, net::buffer(buffer, bytes), net_awaitable[ec]);
+                    to, net::buffer(buffer.data(), bytes), net_awaitable[ec]);
 
             to.shutdown(net::socket_base::shutdown_send, ec);
             co_return;
         }
-        co_await net::async_write(to, net::buffer(buffer, bytes), net_awaitable[ec]);
+        co_await net::async_write(
+            to, net::buffer(buffer.data(), bytes), net_awaitable[ec]);
         if (ec) {
             to.shutdown(net::socket_base::shutdown_send, ec);
             from.shutdown(net::socket_base::shutdown_receive, ec);
             co_return;
         }
         bytes_transferred += bytes;
+
+        if (bytes == buffer.size())
+            buffer_size = std::min(buffer.size() * 2, buffer_pool::max_size);
+        else if (bytes < buffer.size() / 4)
+            buffer_size = std::max(buffer.size() / 2, buffer_pool::min_size);
     }
 }
 
+#ifdef HTTPLIB_HAS_SPLICE
+// transfer() between two plain sockets: the bytes go socket to pipe to socket with
+// splice(2) and never reach user space. Copies when no pipe can be had.
+inline net::awaitable<void> splice_transfer(tcp::socket& from,
+                                            tcp::socket& to,
+                                            std::uint64_t& bytes_transferred) {
+    boost::system::error_code ec;
+    splice_pipe pipe;
+    if (!pipe.open(ec)) {
+        co_await transfer(from, to, bytes_transferred);
+        co_return;
+    }
+    co_await async_splice(from, to, pipe, bytes_transferred, ec);
+
+    bool failed = ec && ec != net::error::eof;
+    to.shutdown(net::socket_base::shutdown_send, ec);
+    if (failed) from.shutdown(net::socket_base::shutdown_receive, ec);
+}
+#endif
+
 
 class websocket_task : public session::task {
 public:
@@ -109,12 +141,13 @@ private:
 class http_proxy_task : public session::task {
 public:
     explicit http_proxy_task(http_variant_stream_type&& stream,
+                             beast::flat_buffer&& buffer,
                              request&& req,
                              const server::setting& option)
         : stream_(std::move(stream))
+        , buffer_(std::move(buffer))
         , req_(std::move(req))
         , option_(option)
-        , resolver_(stream_.get_executor())
         , proxy_socket_(stream_.get_executor()) { }
 
 public:
@@ -127,10 +160,14 @@ public:
         auto port = target.substr(pos + 1);
 
         boost::system::error_code ec;
-        auto results = co_await resolver_.async_resolve(host, port, net_awaitable[ec]);
+        auto results = co_await dns_cache::instance().async_resolve(host, port, ec);
         if (ec) co_return nullptr;
 
-        co_await net::async_connect(proxy_socket_, results, net_awaitable[ec]);
+        co_await async_connect_staggered(proxy_socket_,
+                                         results,
+                                         option_.connect_attempt_delay,
+                                         option_.connect_timeout,
+                                         ec);
         if (ec) co_return nullptr;
 
         auto resp = detail::make_respone(req_);
@@ -141,23 +178,47 @@ public:
 
         // proxy
         using namespace net::experimental::awaitable_operators;
-        size_t l2r_transferred = 0;
-        size_t r2l_transferred = 0;
-        co_await (detail::transfer(stream_, proxy_socket_, l2r_transferred) &&
-                  detail::transfer(proxy_socket_, stream_, r2l_transferred));
+        std::uint64_t l2r_transferred = 0;
+        std::uint64_t r2l_transferred = 0;
+
+        // the client may not have waited for our answer, e.g. a TLS ClientHello sent
+        // along with the CONNECT
+        if (buffer_.size() != 0) {
+            l2r_transferred = co_await net::async_write(
+                proxy_socket_, buffer_.data(), net_awaitable[ec]);
+            if (ec) co_return nullptr;
+            buffer_.consume(buffer_.size());
+        }
+
+#ifdef HTTPLIB_HAS_SPLICE
+        if (auto plain = std::get_if<http_stream>(&stream_)) {
+            auto& client = plain->socket();
+            co_await (detail::splice_transfer(client, proxy_socket_, l2r_transferred) &&
+                      detail::splice_transfer(proxy_socket_, client, r2l_transferred));
+        } else
+#endif
+        {
+            co_await (detail::transfer(stream_, proxy_socket_, l2r_transferred) &&
+                      detail::transfer(proxy_socket_, stream_, r2l_transferred));
+        }
+
+        option_.get_logger()->info("CONNECT {} closed, {} bytes sent, {} bytes received",
+                                   req_.target(),
+                                   l2r_transferred,
+                                   r2l_transferred);
         co_return nullptr;
     }
 
     void abort() override {
         boost::system::error_code ec;
         stream_.close(ec);
-        resolver_.cancel();
         proxy_socket_.close(ec);
     }
 
 private:
     http_variant_stream_type stream_;
-    tcp::resolver resolver_;
+    // bytes the client sent past the CONNECT request
+    beast::flat_buffer buffer_;
     tcp::socket proxy_socket_;
 
     request req_;
@@ -213,11 +274,28 @@ public:
             else if (header.method() == http::verb::connect) {
                 request req(header_parser.release());
                 co_return std::make_unique<http_proxy_task>(
-                    std::move(stream_), std::move(req), option_);
+                    std::move(stream_), std::move(buffer_), std::move(req), option_);
             }
             httplib::response resp = detail::make_respone(header);
             httplib::request req;
-            if (router_.has_handler(header.method(), header.target())) {
+            // unroutable or oversized requests are answered from the header alone,
+            // their body is never materialized and the connection is closed instead
+            // of drained
+            bool body_pending = !header_parser.is_done();
+            route_info route;
+            bool routable = router_.has_handler(header.method(), header.target(), route);
+            std::uint64_t body_limit = std::min(route.body_limit, option_.max_body_size);
+            bool too_large = routable && header_parser.content_length() &&
+                             *header_parser.content_length() > body_limit;
+            std::optional<stream_body_reader> body_stream;
+
+            if (!routable || too_large) {
+                req = httplib::request(header_parser.release());
+            } else if (route.stream_body) {
+                req = httplib::request(http::request_header<>(header));
+                body_stream.emplace(*this, std::move(header_parser), body_limit);
+                req.body_stream = &*body_stream;
+            } else {
                 switch (header.method()) {
                     case http::verb::get:
                     case http::verb::head:
@@ -226,67 +304,88 @@ public:
                         req = httplib::request(header_parser.release());
                         break;
                     default: {
+                        // the client holds the body back until we accept it
+                        if (body_pending && is_expect_continue(header)) {
+                            co_await async_write_continue(ec);
+                            if (ec) {
+                                option_.get_logger()->trace(
+                                    "write 100-continue failed: {}", ec.message());
+                                co_return nullptr;
+                            }
+                        }
                         http::request_parser<body::any_body> body_parser(
                             std::move(header_parser));
+                        // chunked bodies have no length up front, the parser stops
+                        // them once they cross the limit
+                        body_parser.body_limit(body_limit);
                         while (!body_parser.is_done()) {
                             stream_.expires_after(option_.read_timeout);
                             co_await http::async_read_some(
                                 stream_, buffer_, body_parser, net_awaitable[ec]);
                             stream_.expires_never();
+                            if (ec == http::error::body_limit) {
+                                too_large = true;
+                                break;
+                            }
                             if (ec) {
                                 option_.get_logger()->trace("read http body failed: {}",
                                                             ec.message());
                                 co_return nullptr;
                             }
                         }
+                        if (too_large) {
+                            auto partial = body_parser.release();
+                            req = httplib::request(std::move(partial.base()));
+                            break;
+                        }
                         req = body_parser.release();
+                        body_pending = false;
                     } break;
                 }
-                // init request
-                req.local_endpoint = local_endpoint_;
-                req.remote_endpoint = remote_endpoint_;
+            }
+            // init request
+            req.route_snapshot = std::move(route.snapshot);
+            req.local_endpoint = local_endpoint_;
+            req.remote_endpoint = remote_endpoint_;
 
-                auto start_time = std::chrono::steady_clock::now();
+            auto start_time = std::chrono::steady_clock::now();
 
+            if (too_large)
+                resp.set_error_content(http::status::payload_too_large);
+            else
                 co_await router_.routing(req, resp);
 
-                auto span_time = std::chrono::steady_clock::now() - start_time;
-
-                option_.get_logger()->info(
-                    "{} {} ({}:{} -> {}:{}) {} {}ms",
-                    req.method_string(),
-                    req.target(),
-                    remote_endpoint_.address().to_string(),
-                    remote_endpoint_.port(),
-                    local_endpoint_.address().to_string(),
-                    local_endpoint_.port(),
-                    resp.result_int(),
-                    std::chrono::duration_cast<std::chrono::milliseconds>(span_time)
-                        .count());
+            if (body_stream) {
+                if (body_stream->limit_exceeded())
+                    resp.set_error_content(http::status::payload_too_large);
+                body_pending = !body_stream->is_done();
+                req.body_stream = nullptr;
             }
 
-            for (const auto& encoding :
-                 util::split(req[http::field::accept_encoding], ",")) {
-                if (body::compressor_factory::instance().is_supported_encoding(
-                        encoding)) {
-                    resp.set(http::field::content_encoding, encoding);
-                    resp.chunked(true);
-                    break;
-                }
-            }
+            auto span_time = std::chrono::steady_clock::now() - start_time;
+
+            option_.get_logger()->info(
+                "{} {} ({}:{} -> {}:{}) {} {}ms",
+                req.method_string(),
+                req.target(),
+                remote_endpoint_.address().to_string(),
+                remote_endpoint_.port(),
+                local_endpoint_.address().to_string(),
+                local_endpoint_.port(),
+                resp.result_int(),
+                std::chrono::duration_cast<std::chrono::milliseconds>(span_time)
+                    .count());
+
+            if (body_pending) resp.keep_alive(false);
+
+            apply_compression(req, resp);
 
             if (!resp.has_content_length()) resp.prepare_payload();
 
-            http::response_serializer<body::any_body> serializer(resp);
-            while (!serializer.is_done()) {
-                stream_.expires_after(option_.write_timeout);
-                co_await http::async_write_some(stream_, serializer, net_awaitable[ec]);
-                stream_.expires_never();
-                if (ec) {
-                    option_.get_logger()->trace("write http body failed: {}",
-                                                ec.message());
-                    co_return nullptr;
-                }
+            co_await async_write_response(req, resp, ec);
+            if (ec) {
+                option_.get_logger()->trace("write http body failed: {}", ec.message());
+                co_return nullptr;
             }
 
             if (!resp.keep_alive()) {
@@ -308,6 +407,253 @@ public:
     }
 
 private:
+    // Picks a Content-Encoding under option_.compression. Strings and json values are
+    // compressed right away and keep a Content-Length, other bodies are compressed
+    // while they are written, chunked.
+    void apply_compression(const httplib::request& req, httplib::response& resp) const {
+        const auto& policy = option_.compression;
+        if (!policy.enabled || req.method() == http::verb::head) return;
+        // already encoded, e.g. a precompressed sidecar file
+        if (resp.count(http::field::content_encoding)) return;
+        // partial and empty responses describe the identity representation
+        if (resp.result() != http::status::ok) return;
+        auto& content = resp.body();
+        if (content.is_body_type<body::empty_body>()) return;
+        // a json value has no size until it is written, serialized here min_size applies
+        // and it goes the eager way of strings below
+        if (content.is_body_type<body::json_body>()) {
+            auto text = body::json::serialize(content.as<body::json_body>());
+            resp.content_length(text.size());
+            content = std::move(text);
+        }
+
+        std::optional<std::uint64_t> size;
+        auto length = resp[http::field::content_length];
+        if (!length.empty()) {
+            std::uint64_t value = 0;
+            auto last = length.data() + length.size();
+            if (std::from_chars(length.data(), last, value).ec == std::errc {})
+                size = value;
+        }
+        if (!policy.is_compressible(resp[http::field::content_type], size)) return;
+
+        resp.set(http::field::vary, "Accept-Encoding");
+        auto encoding =
+            body::negotiate_encoding(req[http::field::accept_encoding], policy.encodings);
+        if (encoding.empty()) return;
+        auto level = policy.level(encoding);
+
+        if (content.is_body_type<body::string_body>()) {
+            auto& data = content.as<body::string_body>();
+            std::string compressed;
+            if (!body::compress(std::string(encoding), level, data, compressed)) return;
+            // not worth it, incompressible data only grows
+            if (compressed.size() >= data.size()) return;
+
+            data = std::move(compressed);
+            resp.set(http::field::content_encoding, encoding);
+            resp.content_length(data.size());
+            content.set_encoded(true);
+            return;
+        }
+        resp.set(http::field::content_encoding, encoding);
+        content.set_compression_level(level);
+        if (content.is_body_type<body::stream_body>())
+            content.as<body::stream_body>().compress = true;
+        resp.chunked(true);
+    }
+
+    // body of a streaming route, read straight from the connection into the
+    // handler's buffers
+    class stream_body_reader : public body_reader {
+    public:
+        stream_body_reader(http_task& task,
+                           http::request_parser<http::empty_body>&& header_parser,
+                           std::uint64_t limit)
+            : task_(task), parser_(std::move(header_parser)) {
+            parser_.body_limit(limit);
+            // 100 Continue goes out when the handler first asks for the body
+            expect_continue_ = !parser_.is_done() && is_expect_continue(parser_.get());
+        }
+
+        net::awaitable<std::size_t>
+        async_read_some(net::mutable_buffer buffer,
+                        boost::system::error_code& ec) override {
+            ec = {};
+            // nothing could be handed over, the parser would only buffer more input
+            if (buffer.size() == 0) co_return 0;
+            if (expect_continue_) {
+                expect_continue_ = false;
+                co_await task_.async_write_continue(ec);
+                if (ec) co_return 0;
+            }
+            while (!parser_.is_done()) {
+                auto& body = parser_.get().body();
+                body.data = buffer.data();
+                body.size = buffer.size();
+
+                task_.stream_.expires_after(task_.option_.read_timeout);
+                co_await http::async_read_some(
+                    task_.stream_, task_.buffer_, parser_, net_awaitable[ec]);
+                task_.stream_.expires_never();
+                if (ec == http::error::need_buffer) ec = {};
+                if (ec) {
+                    limit_exceeded_ = ec == http::error::body_limit;
+                    co_return 0;
+                }
+                // a read may only consume chunk framing
+                auto n = buffer.size() - parser_.get().body().size;
+                if (n != 0) co_return n;
+            }
+            co_return 0;
+        }
+
+        bool is_done() const override { return parser_.is_done(); }
+        bool limit_exceeded() const { return limit_exceeded_; }
+
+    private:
+        http_task& task_;
+        http::request_parser<http::buffer_body> parser_;
+        bool expect_continue_ = false;
+        bool limit_exceeded_ = false;
+    };
+
+    static bool is_expect_continue(const http::request_header<>& header) {
+        return beast::iequals(header[http::field::expect], "100-continue");
+    }
+
+    net::awaitable<void> async_write_continue(boost::system::error_code& ec) {
+        static constexpr std::string_view continue_line =
+            "HTTP/1.1 100 Continue\r\n\r\n";
+        stream_.expires_after(option_.write_timeout);
+        co_await net::async_write(stream_, net::buffer(continue_line), net_awaitable[ec]);
+        stream_.expires_never();
+    }
+
+    net::awaitable<void> async_write_response(const httplib::request& req,
+                                              httplib::response& resp,
+                                              boost::system::error_code& ec) {
+        if (resp.body().is_body_type<body::stream_body>()) {
+            co_await async_write_stream_response(req, resp, ec);
+            co_return;
+        }
+        http::response_serializer<body::any_body> serializer(resp);
+#ifdef HTTPLIB_HAS_SENDFILE
+        if (auto file = sendfile_body(req, resp)) {
+            serializer.split(true);
+            stream_.expires_after(option_.write_timeout);
+            co_await http::async_write_header(stream_, serializer, net_awaitable[ec]);
+            stream_.expires_never();
+            if (ec) co_return;
+
+            std::uint64_t offset = 0;
+            std::uint64_t count = file->file_size();
+            if (!file->ranges.empty()) {
+                offset = file->ranges.front().first;
+                count = file->ranges.front().second + 1 - offset;
+            }
+            co_await async_sendfile(std::get<http_stream>(stream_).socket(),
+                                    file->native_handle(),
+                                    offset,
+                                    count,
+                                    option_.write_timeout,
+                                    ec);
+            co_return;
+        }
+#endif
+        while (!serializer.is_done()) {
+            stream_.expires_after(option_.write_timeout);
+            co_await http::async_write_some(stream_, serializer, net_awaitable[ec]);
+            stream_.expires_never();
+            if (ec) co_return;
+        }
+    }
+
+    // The header goes out through the serializer, then every chunk the producer hands
+    // over is encoded and written before the producer is awaited again. The write
+    // timeout covers the socket only, a producer may take as long as it needs.
+    net::awaitable<void> async_write_stream_response(const httplib::request& req,
+                                                     httplib::response& resp,
+                                                     boost::system::error_code& ec) {
+        auto& content = resp.body().as<body::stream_body>();
+
+        // only an encoding apply_compression() picked is applied here, the handler's
+        // own Content-Encoding already describes the produced bytes
+        body::compressor_ptr compressor;
+        auto encoding = resp[http::field::content_encoding];
+        if (content.compress && !encoding.empty() && !resp.body().is_encoded()) {
+            auto& factory = body::compressor_factory::instance();
+            compressor =
+                factory.create(std::string(encoding), resp.body().compression_level());
+            if (compressor) compressor->init(body::compressor::mode::encode);
+        }
+        // a Content-Length counts the bytes before compression
+        if (compressor && resp.has_content_length()) resp.chunked(true);
+        // without chunking or a length only closing the connection ends the body
+        if (!resp.chunked() && !resp.has_content_length()) resp.keep_alive(false);
+
+        http::response_serializer<body::any_body> serializer(resp);
+        serializer.split(true);
+        stream_.expires_after(option_.write_timeout);
+        co_await http::async_write_header(stream_, serializer, net_awaitable[ec]);
+        stream_.expires_never();
+        if (ec || req.method() == http::verb::head) co_return;
+
+        const bool chunked = resp.chunked();
+        auto& producer = content.producer;
+
+        for (;;) {
+            std::string chunk;
+            if (producer) chunk = co_await producer();
+            const bool last = chunk.empty();
+
+            net::const_buffer buffer = net::buffer(chunk);
+            if (compressor) {
+                compressor->consume_all();
+                if (last)
+                    compressor->finish();
+                else
+                    compressor->write(buffer);
+                buffer = compressor->buffer();
+            }
+            if (buffer.size() != 0) {
+                stream_.expires_after(option_.write_timeout);
+                if (chunked)
+                    co_await net::async_write(
+                        stream_, http::make_chunk(buffer), net_awaitable[ec]);
+                else
+                    co_await net::async_write(stream_, buffer, net_awaitable[ec]);
+                stream_.expires_never();
+                if (ec) co_return;
+            }
+            if (last) break;
+        }
+        if (chunked) {
+            stream_.expires_after(option_.write_timeout);
+            co_await net::async_write(
+                stream_, http::make_chunk_last(), net_awaitable[ec]);
+            stream_.expires_never();
+        }
+    }
+
+#ifdef HTTPLIB_HAS_SENDFILE
+    // file bodies go through sendfile(2) when nothing has to touch the bytes on their
+    // way out: plain TCP, no encoding left to apply and a whole file or a single range.
+    const body::file_body::value_type* sendfile_body(const httplib::request& req,
+                                                     httplib::response& resp) const {
+        if (req.method() == http::verb::head) return nullptr;
+        if (!std::holds_alternative<http_stream>(stream_)) return nullptr;
+        if (resp.chunked()) return nullptr;
+        if (resp.count(http::field::content_encoding) && !resp.body().is_encoded())
+            return nullptr;
+        if (!resp.body().is_body_type<body::file_body>()) return nullptr;
+
+        const auto& file = resp.body().as<body::file_body>();
+        if (!file.is_open() || file.ranges.size() > 1) return nullptr;
+        return &file;
+    }
+#endif
+
     const server::setting& option_;
     httplib::router& router_;
     http_variant_stream_type stream_;
@@ -322,9 +668,11 @@ public:
     explicit ssl_handshake_task(ssl_http_stream&& stream,
                                 beast::flat_buffer&& buffer,
                                 httplib::router& router,
-                                const server::Option& option)
+                                const server::setting& option,
+                                ssl_context_manager& ssl_contexts)
         : option_(option)
         , router_(router)
+        , ssl_contexts_(ssl_contexts)
         , stream_(std::move(stream))
         , buffer_(std::move(buffer)) { }
 
@@ -338,6 +686,7 @@ public:
             co_return nullptr;
         }
         buffer_.consume(bytes_used);
+        ssl_contexts_.record_handshake(SSL_session_reused(stream_.native_handle()) == 1);
 
         http_variant_stream_type variant_stream(std::move(stream_));
         co_return std::make_unique<http_task>(
@@ -350,6 +699,7 @@ public:
 private:
     const server::setting& option_;
     httplib::router& router_;
+    ssl_context_manager& ssl_contexts_;
     ssl_http_stream stream_;
     beast::flat_buffer buffer_;
 };
@@ -359,8 +709,12 @@ class detect_ssl_task : public session::task {
 public:
     explicit detect_ssl_task(tcp::socket&& stream,
                              const server::setting& option,
-                             httplib::router& router)
-        : option_(option), router_(router), stream_(std::move(stream)) {
+                             httplib::router& router,
+                             ssl_context_manager* ssl_contexts)
+        : option_(option)
+        , router_(router)
+        , ssl_contexts_(ssl_contexts)
+        , stream_(std::move(stream)) {
         stream_.expires_after(option_.read_timeout);
     }
     ~detect_ssl_task() { stream_.expires_never(); }
@@ -369,7 +723,7 @@ public:
     net::awaitable<std::unique_ptr<task>> then() override {
         beast::flat_buffer buffer;
 #ifdef HTTPLIB_ENABLED_SSL
-        if (option_.ssl_conf) {
+        if (option_.ssl_conf && ssl_contexts_) {
             boost::system::error_code ec;
             bool is_ssl =
                 co_await beast::async_detect_ssl(stream_, buffer, net_awaitable[ec]);
@@ -378,7 +732,7 @@ public:
                 co_return nullptr;
             }
             if (is_ssl) {
-                auto ssl_ctx = detail::create_ssl_context(*option_.ssl_conf, ec);
+                auto ssl_ctx = ssl_contexts_->get(ec);
                 if (!ssl_ctx) {
                     option_.get_logger()->error("create_ssl_context failed: {}",
                                                 ec.message());
@@ -386,7 +740,11 @@ public:
                 }
                 ssl_http_stream use_ssl_stream(std::move(stream_), ssl_ctx);
                 co_return std::make_unique<ssl_handshake_task>(
-                    std::move(use_ssl_stream), std::move(buffer), router_, option_);
+                    std::move(use_ssl_stream),
+                    std::move(buffer),
+                    router_,
+                    option_,
+                    *ssl_contexts_);
             }
         }
 #endif
@@ -400,6 +758,7 @@ public:
 private:
     const server::setting& option_;
     httplib::router& router_;
+    ssl_context_manager* ssl_contexts_;
     http_stream stream_;
 };
 
@@ -407,14 +766,16 @@ private:
 
 session::session(tcp::socket&& stream,
                  const server::setting& option,
-                 httplib::router& router)
+                 httplib::router& router,
+                 ssl_context_manager* ssl_contexts)
     : option_(option) {
     remote_endpoint_ = stream.remote_endpoint();
     local_endpoint_ = stream.local_endpoint();
     option_.get_logger()->trace("accept new connection [{}:{}]",
                                 remote_endpoint_.address().to_string(),
                                 remote_endpoint_.port());
-    task_ = std::make_unique<detail::detect_ssl_task>(std::move(stream), option, router);
+    task_ = std::make_unique<detail::detect_ssl_task>(
+        std::move(stream), option, router, ssl_contexts);
 }
 
 session::~session() {
@@ -8,6 +8,8 @@
 namespace httplib {
 class server;
 class router;
+class session_registry;
+class ssl_context_manager;
 
 
 class session : public std::enable_shared_from_this<session> {
@@ -21,7 +23,8 @@ public:
 
     explicit session(tcp::socket&& stream,
                      const server::setting& option,
-                     httplib::router& router);
+                     httplib::router& router,
+                     ssl_context_manager* ssl_contexts);
     ~session();
 
 public:
@@ -36,5 +39,11 @@ private:
     const server::setting& option_;
     std::atomic_bool abort_ = false;
     std::mutex task_mtx_;
+
+    // intrusive hooks owned by session_registry
+    session* registry_prev_ = nullptr;
+    session* registry_next_ = nullptr;
+    std::size_t registry_slot_ = 0;
+    friend class session_registry;
 };
 } // namespace httplib
\ No newline at end of file
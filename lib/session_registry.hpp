@@ -0,0 +1,94 @@
+#pragma once
+#include "session.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace httplib {
+
+// Tracks the live sessions of a server so that server::stop() can abort them.
+//
+// Sessions are linked intrusively into one of several shards. Every io thread
+// registers into its own shard, so insert/erase never contend across threads, and
+// the live count is kept in a single relaxed counter.
+class session_registry {
+public:
+    class registration {
+    public:
+        registration(session_registry& registry, session& s)
+            : registry_(registry), session_(s) {
+            registry_.insert(session_);
+        }
+        ~registration() { registry_.erase(session_); }
+
+        registration(const registration&) = delete;
+        registration& operator=(const registration&) = delete;
+
+    private:
+        session_registry& registry_;
+        session& session_;
+    };
+
+public:
+    explicit session_registry(std::size_t shard_count)
+        : shard_count_((std::max)(shard_count, std::size_t(1)))
+        , shards_(new shard[shard_count_]) { }
+
+    void insert(session& s) {
+        s.registry_slot_ = thread_index() % shard_count_;
+        auto& shard = shards_[s.registry_slot_];
+        {
+            std::unique_lock<std::mutex> lck(shard.mtx);
+            s.registry_prev_ = nullptr;
+            s.registry_next_ = shard.head;
+            if (shard.head) shard.head->registry_prev_ = &s;
+            shard.head = &s;
+        }
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void erase(session& s) {
+        auto& shard = shards_[s.registry_slot_];
+        {
+            std::unique_lock<std::mutex> lck(shard.mtx);
+            if (s.registry_prev_)
+                s.registry_prev_->registry_next_ = s.registry_next_;
+            else
+                shard.head = s.registry_next_;
+            if (s.registry_next_) s.registry_next_->registry_prev_ = s.registry_prev_;
+            s.registry_prev_ = nullptr;
+            s.registry_next_ = nullptr;
+        }
+        count_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void abort_all() {
+        for (std::size_t i = 0; i < shard_count_; ++i) {
+            auto& shard = shards_[i];
+            std::unique_lock<std::mutex> lck(shard.mtx);
+            for (auto s = shard.head; s; s = s->registry_next_)
+                s->abort();
+        }
+    }
+
+    std::size_t size() const noexcept { return count_.load(std::memory_order_relaxed); }
+
+private:
+    static std::size_t thread_index() {
+        static std::atomic_size_t next_index = 0;
+        thread_local std::size_t index = next_index.fetch_add(1);
+        return index;
+    }
+
+    struct alignas(64) shard {
+        std::mutex mtx;
+        session* head = nullptr;
+    };
+
+    std::size_t shard_count_;
+    std::unique_ptr<shard[]> shards_;
+    std::atomic_size_t count_ = 0;
+};
+
+} // namespace httplib
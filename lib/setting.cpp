@@ -1,5 +1,7 @@
 #include "httplib/setting.hpp"
 
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
@@ -20,4 +22,22 @@ void server::setting::set_logger(std::shared_ptr<spdlog::logger> logger) {
     custom_logger_ = logger;
 }
 
+int server::setting::compression_policy::level(std::string_view encoding) const {
+    auto iter = levels.find(std::string(encoding));
+    return iter != levels.end() ? iter->second : -1;
+}
+
+bool server::setting::compression_policy::is_compressible(
+    std::string_view content_type, std::optional<std::uint64_t> size) const {
+    if (!enabled || content_type.empty()) return false;
+    if (size && *size < min_size) return false;
+
+    auto matches = [&](const std::vector<std::string>& prefixes) {
+        return std::any_of(prefixes.begin(), prefixes.end(), [&](const auto& prefix) {
+            return boost::istarts_with(content_type, prefix);
+        });
+    };
+    return matches(mime_types) && !matches(compressed_mime_types);
+}
+
 } // namespace httplib
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "ssl_context_manager.hpp"
+
+#ifdef HTTPLIB_ENABLED_SSL
+#include <cstring>
+#include <deque>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+#include <spdlog/spdlog.h>
+#endif
+
+namespace httplib {
+
+#ifdef HTTPLIB_ENABLED_SSL
+class ssl_context_manager::ticket_keys {
+public:
+    struct key {
+        unsigned char name[16];
+        unsigned char aes_key[32];
+        unsigned char hmac_key[32];
+        std::chrono::steady_clock::time_point created;
+    };
+
+    // the key new tickets are sealed with, rotated once it is older than the lifetime
+    bool current(key& out) {
+        auto now = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lck(mtx_);
+        if (keys_.empty() || now - keys_.front().created >= ticket_key_lifetime) {
+            key k;
+            if (RAND_bytes(k.name, sizeof(k.name)) <= 0 ||
+                RAND_bytes(k.aes_key, sizeof(k.aes_key)) <= 0 ||
+                RAND_bytes(k.hmac_key, sizeof(k.hmac_key)) <= 0)
+                return false;
+            k.created = now;
+            keys_.push_front(k);
+            // the previous key stays around to open tickets it issued
+            while (keys_.size() > 2)
+                keys_.pop_back();
+        }
+        out = keys_.front();
+        return true;
+    }
+
+    bool find(const unsigned char* name, key& out, bool& is_current) {
+        auto now = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lck(mtx_);
+        for (std::size_t i = 0; i < keys_.size(); ++i) {
+            if (std::memcmp(keys_[i].name, name, sizeof(key::name)) != 0) continue;
+            if (now - keys_[i].created >= 2 * ticket_key_lifetime) return false;
+            out = keys_[i];
+            is_current = i == 0;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    std::mutex mtx_;
+    std::deque<key> keys_;
+};
+
+namespace detail {
+
+static int ticket_keys_index() {
+    static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+using ticket_mac_ctx = EVP_MAC_CTX;
+
+static bool init_ticket_mac(ticket_mac_ctx* ctx, unsigned char* key, std::size_t size) {
+    OSSL_PARAM params[3];
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key, size);
+    params[1] = OSSL_PARAM_construct_utf8_string(
+        OSSL_MAC_PARAM_DIGEST, const_cast<char*>("SHA256"), 0);
+    params[2] = OSSL_PARAM_construct_end();
+    return EVP_MAC_CTX_set_params(ctx, params) == 1;
+}
+#else
+using ticket_mac_ctx = HMAC_CTX;
+
+static bool init_ticket_mac(ticket_mac_ctx* ctx, unsigned char* key, std::size_t size) {
+    return HMAC_Init_ex(ctx, key, static_cast<int>(size), EVP_sha256(), nullptr) == 1;
+}
+#endif
+
+// RFC 5077 ticket sealing: 1 = ok, 2 = ok but issue a fresh ticket, 0 = unknown key
+// (fall back to a full handshake), -1 = error.
+static int ticket_key_callback(SSL* ssl,
+                               unsigned char* key_name,
+                               unsigned char* iv,
+                               EVP_CIPHER_CTX* cipher_ctx,
+                               ticket_mac_ctx* mac_ctx,
+                               int enc) {
+    auto keys = static_cast<ssl_context_manager::ticket_keys*>(
+        SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ticket_keys_index()));
+    if (!keys) return -1;
+
+    const EVP_CIPHER* cipher = EVP_aes_256_cbc();
+    ssl_context_manager::ticket_keys::key key;
+    if (enc) {
+        if (!keys->current(key)) return -1;
+        if (RAND_bytes(iv, EVP_CIPHER_iv_length(cipher)) <= 0) return -1;
+        std::memcpy(key_name, key.name, sizeof(key.name));
+        if (EVP_EncryptInit_ex(cipher_ctx, cipher, nullptr, key.aes_key, iv) != 1)
+            return -1;
+        if (!init_ticket_mac(mac_ctx, key.hmac_key, sizeof(key.hmac_key))) return -1;
+        return 1;
+    }
+
+    bool is_current = false;
+    if (!keys->find(key_name, key, is_current)) return 0;
+    if (!init_ticket_mac(mac_ctx, key.hmac_key, sizeof(key.hmac_key))) return -1;
+    if (EVP_DecryptInit_ex(cipher_ctx, cipher, nullptr, key.aes_key, iv) != 1) return -1;
+    return is_current ? 1 : 2;
+}
+
+static bool same_ssl_config(const server::setting::SSLConfig& lhs,
+                            const server::setting::SSLConfig& rhs) {
+    return lhs.cert_file == rhs.cert_file && lhs.key_file == rhs.key_file &&
+           lhs.passwd == rhs.passwd;
+}
+
+} // namespace detail
+#endif
+
+ssl_context_manager::ssl_context_manager(const server::setting& option) : option_(option) {
+#ifdef HTTPLIB_ENABLED_SSL
+    ticket_keys_ = std::make_unique<ticket_keys>();
+#endif
+}
+
+ssl_context_manager::~ssl_context_manager() = default;
+
+#ifdef HTTPLIB_ENABLED_SSL
+std::shared_ptr<ssl::context>
+ssl_context_manager::create_ssl_context(const server::setting::SSLConfig& ssl_conf,
+                                        boost::system::error_code& ec) {
+    unsigned long ssl_options = ssl::context::default_workarounds |
+                                ssl::context::no_sslv2 | ssl::context::single_dh_use;
+
+    auto ssl_ctx = std::make_shared<ssl::context>(ssl::context::sslv23);
+    ssl_ctx->set_options(ssl_options, ec);
+    if (ec) return nullptr;
+
+    if (!ssl_conf.passwd.empty()) {
+        ssl_ctx->set_password_callback(
+            [pass = ssl_conf.passwd](auto, auto) { return pass; }, ec);
+        if (ec) return nullptr;
+    }
+    ssl_ctx->use_certificate_chain_file(ssl_conf.cert_file.string(), ec);
+    if (ec) return nullptr;
+
+    ssl_ctx->use_private_key_file(ssl_conf.key_file.string(), ssl::context::pem, ec);
+    if (ec) return nullptr;
+
+    // session resumption
+    static constexpr unsigned char session_id_context[] = "httplib";
+    auto handle = ssl_ctx->native_handle();
+    SSL_CTX_set_session_cache_mode(handle, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_session_id_context(handle, session_id_context, sizeof(session_id_context));
+    SSL_CTX_sess_set_cache_size(handle, session_cache_size);
+    SSL_CTX_set_timeout(
+        handle,
+        static_cast<long>(
+            std::chrono::duration_cast<std::chrono::seconds>(session_timeout).count()));
+    SSL_CTX_set_ex_data(handle, detail::ticket_keys_index(), ticket_keys_.get());
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(handle, detail::ticket_key_callback);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(handle, detail::ticket_key_callback);
+#endif
+
+    return ssl_ctx;
+}
+
+std::shared_ptr<ssl::context> ssl_context_manager::get(boost::system::error_code& ec) {
+    ec = {};
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    auto current = state_.load(std::memory_order_acquire);
+    if (current && now < next_check_.load(std::memory_order_relaxed)) return current->ctx;
+
+    std::unique_lock<std::mutex> lck(reload_mtx_, std::try_to_lock);
+    if (!lck.owns_lock()) {
+        // another session is already checking the files
+        if (current) return current->ctx;
+        lck.lock();
+        current = state_.load(std::memory_order_acquire);
+        if (current) return current->ctx;
+    }
+    next_check_.store(
+        now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(check_interval)
+                  .count(),
+        std::memory_order_relaxed);
+
+    auto next = std::make_shared<state>();
+    next->conf = *option_.ssl_conf;
+
+    std::error_code fec;
+    next->cert_write_time = fs::last_write_time(next->conf.cert_file, fec);
+    next->key_write_time = fs::last_write_time(next->conf.key_file, fec);
+
+    if (current && detail::same_ssl_config(current->conf, next->conf) &&
+        current->cert_write_time == next->cert_write_time &&
+        current->key_write_time == next->key_write_time)
+        return current->ctx;
+
+    next->ctx = create_ssl_context(next->conf, ec);
+    if (!next->ctx) {
+        if (!current) return nullptr;
+        option_.get_logger()->warn("reload ssl context failed, keep the previous one: {}",
+                                   ec.message());
+        ec = {};
+        return current->ctx;
+    }
+    if (current) option_.get_logger()->info("ssl context reloaded");
+
+    state_.store(next, std::memory_order_release);
+    return next->ctx;
+}
+#endif
+
+} // namespace httplib
@@ -0,0 +1,73 @@
+#pragma once
+#include "httplib/setting.hpp"
+#include "httplib/tls_stats.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#ifdef HTTPLIB_ENABLED_SSL
+#include <boost/asio/ssl/context.hpp>
+#endif
+
+namespace httplib {
+
+// Builds the server ssl::context once per server::setting::SSLConfig and shares it
+// between all TLS sessions.
+//
+// The certificate and key files are checked for changes at most once per
+// `check_interval`. A change rebuilds the context and publishes it atomically; sessions
+// that already started keep the context they were created with. When the rebuild fails
+// the previous context stays in use.
+//
+// Every context gets an in-memory session cache and session tickets. The ticket keys
+// belong to the manager, so tickets survive a context reload, and they rotate every
+// `ticket_key_lifetime`; tickets sealed with the previous key are still accepted and
+// renewed.
+class ssl_context_manager {
+public:
+    static constexpr auto check_interval = std::chrono::seconds(5);
+    static constexpr auto ticket_key_lifetime = std::chrono::hours(12);
+    static constexpr long session_cache_size = 20480;
+    static constexpr auto session_timeout = std::chrono::hours(24);
+
+    explicit ssl_context_manager(const server::setting& option);
+    ~ssl_context_manager();
+
+    void record_handshake(bool resumed) noexcept {
+        (resumed ? resumed_ : full_).fetch_add(1, std::memory_order_relaxed);
+    }
+    tls_handshake_stats stats() const noexcept {
+        return {full_.load(std::memory_order_relaxed),
+                resumed_.load(std::memory_order_relaxed)};
+    }
+
+#ifdef HTTPLIB_ENABLED_SSL
+    class ticket_keys;
+
+    std::shared_ptr<ssl::context> get(boost::system::error_code& ec);
+
+private:
+    std::shared_ptr<ssl::context> create_ssl_context(
+        const server::setting::SSLConfig& ssl_conf, boost::system::error_code& ec);
+
+    std::unique_ptr<ticket_keys> ticket_keys_;
+
+    struct state {
+        server::setting::SSLConfig conf;
+        fs::file_time_type cert_write_time;
+        fs::file_time_type key_write_time;
+        std::shared_ptr<ssl::context> ctx;
+    };
+
+    std::atomic<std::shared_ptr<const state>> state_;
+    std::atomic<std::chrono::steady_clock::rep> next_check_ = 0;
+    std::mutex reload_mtx_;
+#endif
+
+private:
+    const server::setting& option_;
+    std::atomic_uint64_t full_ = 0;
+    std::atomic_uint64_t resumed_ = 0;
+};
+
+} // namespace httplib
@@ -0,0 +1,137 @@
+#pragma once
+#include "httplib/config.hpp"
+#include "httplib/use_awaitable.hpp"
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/beast/core/error.hpp>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace httplib {
+
+namespace detail {
+
+// Resolver order with the address families alternating, starting with the family of
+// the first answer (RFC 8305, 4).
+inline std::vector<tcp::endpoint>
+interleave_families(const tcp::resolver::results_type& results) {
+    std::vector<tcp::endpoint> first, second;
+    for (const auto& entry : results) {
+        auto endpoint = entry.endpoint();
+        if (first.empty() || endpoint.protocol() == first.front().protocol())
+            first.push_back(endpoint);
+        else
+            second.push_back(endpoint);
+    }
+
+    std::vector<tcp::endpoint> endpoints;
+    endpoints.reserve(first.size() + second.size());
+    for (std::size_t i = 0; i < std::max(first.size(), second.size()); ++i) {
+        if (i < first.size()) endpoints.push_back(first[i]);
+        if (i < second.size()) endpoints.push_back(second[i]);
+    }
+    return endpoints;
+}
+
+// shared by the attempts of one connect, only touched on its strand
+struct connect_race {
+    explicit connect_race(const net::any_io_executor& ex) : wakeup(ex) { }
+
+    std::vector<std::unique_ptr<tcp::socket>> sockets;
+    std::optional<std::size_t> winner;
+    std::size_t running = 0;
+    boost::system::error_code error;
+    net::steady_timer wakeup;
+};
+
+inline net::awaitable<void>
+connect_attempt(std::shared_ptr<connect_race> race, std::size_t index, tcp::endpoint ep) {
+    boost::system::error_code ec;
+    co_await race->sockets[index]->async_connect(ep, net_awaitable[ec]);
+    race->running--;
+    if (!ec && !race->winner)
+        race->winner = index;
+    else if (ec && ec != net::error::operation_aborted)
+        race->error = ec;
+    race->wakeup.cancel();
+}
+
+inline net::awaitable<void> run_connect_race(tcp::socket& socket,
+                                             std::vector<tcp::endpoint> endpoints,
+                                             std::chrono::steady_clock::duration delay,
+                                             std::chrono::steady_clock::duration timeout,
+                                             boost::system::error_code& ec) {
+    using clock = std::chrono::steady_clock;
+
+    auto ex = co_await net::this_coro::executor;
+    auto race = std::make_shared<connect_race>(ex);
+    auto deadline = timeout == clock::duration::max() ? clock::time_point::max()
+                                                      : clock::now() + timeout;
+    auto next_at = clock::time_point::min();
+    std::size_t next = 0;
+
+    while (!race->winner && (race->running != 0 || next < endpoints.size())) {
+        auto now = clock::now();
+        if (now >= deadline) {
+            ec = beast::error::timeout;
+            break;
+        }
+        // the next attempt starts after `delay`, or right away once all others failed
+        if (next < endpoints.size() && (race->running == 0 || now >= next_at)) {
+            race->sockets.push_back(std::make_unique<tcp::socket>(socket.get_executor()));
+            race->running++;
+            net::co_spawn(
+                ex, connect_attempt(race, next, endpoints[next]), net::detached);
+            next++;
+            next_at = now + delay;
+        }
+        race->wakeup.expires_at(next < endpoints.size() ? std::min(next_at, deadline)
+                                                        : deadline);
+        boost::system::error_code wait_ec;
+        co_await race->wakeup.async_wait(net_awaitable[wait_ec]);
+    }
+
+    // the losers are cancelled by closing their sockets
+    for (std::size_t i = 0; i < race->sockets.size(); ++i) {
+        boost::system::error_code ignored;
+        if (i != race->winner) race->sockets[i]->close(ignored);
+    }
+    if (race->winner) {
+        socket = std::move(*race->sockets[*race->winner]);
+        ec = {};
+    } else if (!ec) {
+        ec = race->error ? race->error : net::error::host_not_found;
+    }
+}
+
+} // namespace detail
+
+// Connects `socket` to one of `results` the way RFC 8305 suggests: attempts start
+// `attempt_delay` apart, alternating address families, and run in parallel. The first
+// connection wins and the others are cancelled, so a blackholed address only costs
+// `attempt_delay` instead of a full TCP timeout. Fails with beast::error::timeout when
+// nothing connects within `timeout`.
+inline net::awaitable<void>
+async_connect_staggered(tcp::socket& socket,
+                        const tcp::resolver::results_type& results,
+                        std::chrono::steady_clock::duration attempt_delay,
+                        std::chrono::steady_clock::duration timeout,
+                        boost::system::error_code& ec) {
+    ec = {};
+    auto endpoints = detail::interleave_families(results);
+
+    // the attempts and the race share state, a strand keeps them in sequence
+    auto strand = net::make_strand(socket.get_executor());
+    co_await net::co_spawn(strand,
+                           detail::run_connect_race(
+                               socket, std::move(endpoints), attempt_delay, timeout, ec),
+                           net::use_awaitable);
+}
+
+} // namespace httplib
@@ -0,0 +1,69 @@
+#pragma once
+#include "httplib/config.hpp"
+#include "httplib/use_awaitable.hpp"
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/error.hpp>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+namespace httplib {
+
+#ifdef __linux__
+#define HTTPLIB_HAS_SENDFILE 1
+
+// Sends [offset, offset + count) of the file `fd` on `sock` with sendfile(2). The bytes
+// never enter user space; whenever the socket send buffer is full we wait for the
+// socket to become writable again, for at most `timeout`.
+inline net::awaitable<void> async_sendfile(tcp::socket& sock,
+                                           int fd,
+                                           std::uint64_t offset,
+                                           std::uint64_t count,
+                                           net::steady_timer::duration timeout,
+                                           boost::system::error_code& ec) {
+    using namespace net::experimental::awaitable_operators;
+    // sendfile(2) transfers at most 0x7ffff000 bytes per call
+    static constexpr std::uint64_t max_chunk_size = 0x7ffff000;
+
+    ec = {};
+    sock.native_non_blocking(true, ec);
+    if (ec) co_return;
+
+    net::steady_timer timer(sock.get_executor());
+    while (count > 0) {
+        off_t off = static_cast<off_t>(offset);
+        auto bytes = ::sendfile(
+            sock.native_handle(), fd, &off, (std::min)(count, max_chunk_size));
+        if (bytes > 0) {
+            offset += bytes;
+            count -= bytes;
+            continue;
+        }
+        if (bytes == 0) {
+            // the file was truncated behind our back
+            ec = net::error::eof;
+            co_return;
+        }
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            ec.assign(errno, boost::system::system_category());
+            co_return;
+        }
+
+        timer.expires_after(timeout);
+        auto result =
+            co_await (sock.async_wait(tcp::socket::wait_write, net_awaitable[ec]) ||
+                      timer.async_wait(net_awaitable));
+        if (result.index() == 1) {
+            ec = beast::error::timeout;
+            co_return;
+        }
+        if (ec) co_return;
+    }
+}
+#endif
+
+} // namespace httplib
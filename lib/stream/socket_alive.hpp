@@ -0,0 +1,25 @@
+#pragma once
+#include "httplib/config.hpp"
+#include <boost/asio/ip/tcp.hpp>
+
+namespace httplib {
+
+// An idle keep-alive connection is alive only if a non-blocking peek would block:
+// data or EOF waiting on it means the peer is done with it.
+inline bool is_socket_alive(tcp::socket& sock) {
+    if (!sock.is_open()) return false;
+
+    bool non_blocking = sock.non_blocking();
+    boost::system::error_code ec;
+    sock.non_blocking(true, ec);
+    if (ec) return false;
+
+    char c;
+    sock.receive(net::buffer(&c, 1), tcp::socket::message_peek, ec);
+
+    boost::system::error_code ignored;
+    sock.non_blocking(non_blocking, ignored);
+    return ec == net::error::would_block;
+}
+
+} // namespace httplib
@@ -0,0 +1,112 @@
+#pragma once
+#include "httplib/config.hpp"
+#include "httplib/use_awaitable.hpp"
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/error.hpp>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace httplib {
+
+#ifdef __linux__
+#define HTTPLIB_HAS_SPLICE 1
+
+// The pipe splice(2) moves socket data through, one per direction of a tunnel.
+class splice_pipe {
+public:
+    splice_pipe() = default;
+    splice_pipe(const splice_pipe&) = delete;
+    splice_pipe& operator=(const splice_pipe&) = delete;
+    ~splice_pipe() {
+        if (fds_[0] != -1) ::close(fds_[0]);
+        if (fds_[1] != -1) ::close(fds_[1]);
+    }
+
+    bool open(boost::system::error_code& ec) {
+        if (::pipe2(fds_, O_NONBLOCK | O_CLOEXEC) != 0) {
+            ec.assign(errno, boost::system::system_category());
+            return false;
+        }
+        // a larger pipe means fewer wakeups on busy tunnels, the default is fine too
+        ::fcntl(fds_[1], F_SETPIPE_SZ, pipe_size);
+        return true;
+    }
+
+    int read_end() const { return fds_[0]; }
+    int write_end() const { return fds_[1]; }
+
+private:
+    static constexpr int pipe_size = 256 * 1024;
+    int fds_[2] = {-1, -1};
+};
+
+// Moves everything `from` sends into `to` with splice(2), socket to pipe to socket, so
+// the payload never enters user space. Each side is only touched once the reactor
+// reports it ready. Ends with net::error::eof when `from` is done and everything has
+// been delivered; `bytes_transferred` counts the bytes written to `to`.
+inline net::awaitable<void> async_splice(tcp::socket& from,
+                                         tcp::socket& to,
+                                         splice_pipe& pipe,
+                                         std::uint64_t& bytes_transferred,
+                                         boost::system::error_code& ec) {
+    static constexpr std::size_t max_chunk_size = 1024 * 1024;
+    static constexpr unsigned flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+
+    ec = {};
+    from.native_non_blocking(true, ec);
+    if (!ec) to.native_non_blocking(true, ec);
+    if (ec) co_return;
+
+    std::size_t in_pipe = 0;
+    for (;;) {
+        // deliver what the pipe holds before taking more
+        while (in_pipe > 0) {
+            auto bytes = ::splice(
+                pipe.read_end(), nullptr, to.native_handle(), nullptr, in_pipe, flags);
+            if (bytes > 0) {
+                in_pipe -= bytes;
+                bytes_transferred += bytes;
+                continue;
+            }
+            if (bytes < 0 && errno == EINTR) continue;
+            if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                co_await to.async_wait(tcp::socket::wait_write, net_awaitable[ec]);
+                if (ec) co_return;
+                continue;
+            }
+            if (bytes == 0)
+                ec = net::error::broken_pipe;
+            else
+                ec.assign(errno, boost::system::system_category());
+            co_return;
+        }
+
+        auto bytes = ::splice(from.native_handle(),
+                              nullptr,
+                              pipe.write_end(),
+                              nullptr,
+                              max_chunk_size,
+                              flags);
+        if (bytes > 0) {
+            in_pipe += bytes;
+            continue;
+        }
+        if (bytes == 0) {
+            ec = net::error::eof;
+            co_return;
+        }
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            ec.assign(errno, boost::system::system_category());
+            co_return;
+        }
+        co_await from.async_wait(tcp::socket::wait_read, net_awaitable[ec]);
+        if (ec) co_return;
+    }
+}
+#endif
+
+} // namespace httplib
@@ -1,6 +1,7 @@
 #pragma once
 #include "httplib/config.hpp"
 #include "httplib/util/type_traits.h"
+#include "socket_alive.hpp"
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/core/basic_stream.hpp>
 #include <type_traits>
@@ -92,11 +93,7 @@ public:
     void close(boost::system::error_code& ec) { lowest_layer().close(ec); }
     bool is_connected()
     {
-        if (!lowest_layer().is_open()) return false;
-
-        boost::system::error_code ec;
-        static_cast<tcp::socket&>(lowest_layer()).receive(net::mutable_buffer(), 0, ec);
-        return !ec;
+        return is_socket_alive(static_cast<tcp::socket&>(lowest_layer()));
     }
 };
 